@@ -0,0 +1,171 @@
+/***************************************************************************
+benchmark.c
+
+The on-board benchmark: time a fixed set of drawing jobs on whatever display
+ is attached, and report how long each took. The E_DELAY and R_DELAY
+ constants for the ks0108b were found by trial and error, and displays from
+ different batches don't all behave the same, so this gives us real numbers
+ to compare against. Like the demo, it lives in its own file so it's easy to
+ pull out if the space is needed.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include "lcd.h"
+#include "serial.h"
+#include "glcdbp.h"
+#include "benchmark.h"
+
+// This is counted by the Timer2 overflow interrupt, in interrupts.c.
+extern volatile uint16_t timer2Overflows;
+
+// These variables are defined in lcd.c.
+extern uint8_t  yDim;
+extern uint8_t  xDim;
+
+// Timer1 is busy making the backlight PWM, so we time things with Timer2,
+//  running freely at clk/8. That's two ticks per microsecond at 16MHz; the
+//  counter only goes to 255, so the overflow interrupt counts the rest.
+#define BENCH_TICKS_PER_US (F_CPU/8000000UL)
+
+static void benchTimerStart(void)
+{
+  TCCR2B = 0;             // Stop the clock while we set up.
+  TCCR2A = 0;             // Normal mode: count up, roll over at 255.
+  TCNT2 = 0;
+  TIFR2 = (1<<TOV2);      // Writing a 1 clears any old overflow flag.
+  timer2Overflows = 0;
+  TIMSK2 = (1<<TOIE2);    // Interrupt on overflow...
+  TCCR2B = (1<<CS21);     // ...and go, at clk/8.
+}
+
+static void benchTimerStop(void)
+{
+  TCCR2B = 0;
+  TIMSK2 = 0;
+}
+
+// Microseconds since benchTimerStart(). If the counter has rolled over and
+//  the interrupt hasn't had a chance to count it yet, the flag will be set
+//  and the count will be low, so we count it ourselves.
+static uint32_t benchMicros(void)
+{
+  uint8_t count;
+  uint16_t overflows;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    count = TCNT2;
+    overflows = timer2Overflows;
+    if ((TIFR2 & (1<<TOV2)) && (count < 128)) overflows++;
+  }
+  return ((((uint32_t)overflows)<<8) | count) / BENCH_TICKS_PER_US;
+}
+
+// The lines have to be the same every time, or the numbers won't compare.
+static uint16_t benchSeed;
+
+static uint8_t benchRandom(uint8_t limit)
+{
+  benchSeed = benchSeed * 25173 + 13849;
+  return (benchSeed >> 8) % limit;
+}
+
+// Our results go out as 16 bits; anything that won't fit is just "a lot".
+static uint16_t benchResult(uint32_t total, uint16_t count)
+{
+  total /= count;
+  if (total > 0xFFFF) return 0xFFFF;
+  return total;
+}
+
+// Draw a number on the screen, for the summary.
+static void benchDrawNumber(uint16_t number)
+{
+  char digits[5];
+  uint8_t i = 0;
+  do
+  {
+    digits[i++] = '0' + (number % 10);
+    number /= 10;
+  } while (number != 0);
+  while (i > 0) lcdDrawChar(digits[--i]);
+}
+
+void benchmark(void)
+{
+  uint16_t results[BENCH_RESULTS];
+  uint16_t pixels = 0;
+  char buffer[8];
+
+  // Everything gets drawn on the whole screen, whatever the clip rectangle
+  //  was.
+  lcdSetClip(0, 0, 255, 255);
+  benchSeed = 1;
+
+  // Each job ends with a flush, so a shadow framebuffer can't hide any of
+  //  the work from us.
+  benchTimerStart();
+  lcdClearScreen();
+  lcdFlush();
+  results[BENCH_CLEAR] = benchResult(benchMicros(), 1);
+
+  benchTimerStart();
+  for (uint8_t i = 0; i < 100; i++) lcdDrawChar('!' + (i % 94));
+  lcdFlush();
+  results[BENCH_CHAR] = benchResult(benchMicros(), 100);
+
+  // Lines get charged by the pixel, since how long one takes depends so much
+  //  on how long it is. A line covers one pixel per step along its longer
+  //  side.
+  benchTimerStart();
+  for (uint8_t i = 0; i < 50; i++)
+  {
+    uint8_t x0 = benchRandom(xDim);
+    uint8_t y0 = benchRandom(yDim);
+    uint8_t x1 = benchRandom(xDim);
+    uint8_t y1 = benchRandom(yDim);
+    lcdDrawLine(x0, y0, x1, y1, ON);
+    uint8_t dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
+    uint8_t dy = (y1 > y0) ? (y1 - y0) : (y0 - y1);
+    pixels += ((dx > dy) ? dx : dy) + 1;
+  }
+  lcdFlush();
+  results[BENCH_LINE] = benchResult(benchMicros(), pixels);
+
+  benchTimerStart();
+  for (uint8_t i = 0; i < 20; i++)
+  {
+    lcdDrawSprite((i * 13) % (xDim - 8), (i * 7) % (yDim - 8), i, '0', ON);
+  }
+  lcdFlush();
+  results[BENCH_SPRITE] = benchResult(benchMicros(), 20);
+  benchTimerStop();
+
+  // Send the results back: how many there are, then each one, high byte
+  //  first.
+  putChar(BENCH_RESULTS);
+  for (uint8_t i = 0; i < BENCH_RESULTS; i++)
+  {
+    putChar(results[i]>>8);
+    putChar(results[i] & 0xFF);
+  }
+
+  // And leave them on the screen, too.
+  lcdClearScreen();
+  for (uint8_t i = 0; i < BENCH_RESULTS; i++)
+  {
+    strcpy_P(buffer, (PGM_P)pgm_read_word(&(benchLabels[i])));
+    for (uint8_t j = 0; buffer[j] != '\0'; j++) lcdDrawChar(buffer[j]);
+    lcdDrawChar(' ');
+    benchDrawNumber(results[i]);
+    lcdDrawChar('u');
+    lcdDrawChar('s');
+    lcdDrawChar('\r');
+  }
+  lcdFlush();
+}
@@ -0,0 +1,42 @@
+/***************************************************************************
+benchmark.h
+
+Header file for the on-board benchmark. Includes the function prototype and
+ the flash stored labels for the on-screen summary.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __benchmark_h
+#define __benchmark_h
+
+#include <avr/pgmspace.h>
+
+// How many results benchmark() reports, in this order. See ui.h.
+#define BENCH_CLEAR   0   // us per full screen clear
+#define BENCH_CHAR    1   // us per character
+#define BENCH_LINE    2   // us per pixel of line
+#define BENCH_SPRITE  3   // us per sprite
+#define BENCH_RESULTS 4
+
+static char benchLabel_1[] PROGMEM = "clear  \0";
+static char benchLabel_2[] PROGMEM = "char   \0";
+static char benchLabel_3[] PROGMEM = "line px\0";
+static char benchLabel_4[] PROGMEM = "sprite \0";
+
+// Marked unused for the files that include this but don't print it; see
+//  lcd.h.
+static PGM_P benchLabels[] PROGMEM __attribute__((unused)) =
+{
+  benchLabel_1,
+  benchLabel_2,
+  benchLabel_3,
+  benchLabel_4
+};
+
+void    benchmark(void);
+
+#endif
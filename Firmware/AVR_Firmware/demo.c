@@ -47,6 +47,7 @@ void demo(void)
       lcdDrawChar(buffer[j++]);
     }
     lcdDrawChar('\r');
+    lcdFlush();
     _delay_ms(750);
     j = 0;  // Before each line, we need to reset our string counter.
     // Also, for dramatic effect, we want to do a couple of things after
@@ -77,12 +78,14 @@ void demo(void)
     onOff ^= 0x01;
   }  
   
+  lcdFlush();
   _delay_ms(500);
   
   // Next, let's draw some awesome concentric circles across the screen.
   for (i = 2; i < (xDim/2); i += 8)
   {
     lcdDrawCircle(xDim/2, yDim/2, i, ON);
+    lcdFlush();
     _delay_ms(250);
   } 
     
@@ -96,6 +99,7 @@ void demo(void)
       else          lcdDrawSprite(i, j, 5, '0', ON);
       openShut ^= 0x01;
       lcdDrawSprite(i+10, j, 0, '0', ON);
+      lcdFlush();
       _delay_ms(200);
       lcdEraseBlock(i, j, i+7, j+7);
       lcdEraseBlock(i+10, j, i+17, j+7);
@@ -24,7 +24,9 @@ static char string_4[] PROGMEM = "Oh how we laughed and laughed!\0";
 static char string_5[] PROGMEM = "Except I wasn't laughing.\0";
 static char string_6[] PROGMEM = "Under the circumstances, I've been SHOCKINGLY nice.\0";
 
-static PGM_P wantYouGone[] PROGMEM =
+// Marked unused for the files that include this but don't print it; see
+//  lcd.h.
+static PGM_P wantYouGone[] PROGMEM __attribute__((unused)) =
 {
   string_1,
   string_2,
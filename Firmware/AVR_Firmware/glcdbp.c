@@ -25,18 +25,36 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 
 // These variables will be used over and over, in various files, to access
 //  global variables that may be needed to make decisions elsewhere.
+#ifndef DISPLAY_FIXED
 enum DISPLAY_TYPE   display = SMALL;
+#endif
 volatile uint8_t    rxRingBuffer[BUF_DEPTH];
-volatile uint8_t    bufferSize = 0;
-volatile uint16_t   rxRingHead = 0;
-volatile uint16_t   rxRingTail = 0;
+volatile uint8_t    rxRingHead = 0;       // Only the receive interrupt
+                                          //  writes this...
+volatile uint8_t    rxRingTail = 0;       // ...and only the main loop writes
+                                          //  this one.
+volatile uint8_t    txRingBuffer[TX_DEPTH];
+volatile uint8_t    txRingHead = 0;       // The main loop writes this one...
+volatile uint8_t    txRingTail = 0;       // ...and the transmit interrupt
+                                          //  writes this one.
+volatile uint8_t    txFlowChar = 0;       // XON or XOFF, waiting to jump the
+                                          //  queue. 0 if there isn't one.
 volatile uint8_t    reverse = 0;
+uint8_t             flowControl = 0;      // FLOW_XONXOFF and/or FLOW_RTS.
+volatile uint8_t    rxThrottled = 0;      // Have we told the host to stop?
+volatile uint16_t   rxOverflows = 0;      // Bytes dropped on a full buffer.
+volatile uint16_t   rxOverruns = 0;       // Bytes the USART lost because
+                                          //  we didn't get to them in time.
+volatile uint8_t    rxHighWater = 0;      // Most bytes ever in the buffer.
+volatile uint16_t   timer2Overflows = 0;  // For the benchmark's timing.
 
 int main(void)
 {
   // The first thing we want to check is if we have a large or small
   //  display on our hands. We can tell because PB3 will be pulled high if
-  //  the display is large (hopefully; that's done at build time).
+  //  the display is large (hopefully; that's done at build time). A
+  //  single-display build already knows.
+#ifndef DISPLAY_FIXED
   PORTB |= 0x08;   // Enable the pull-up on PB3.
   _delay_us(5);    // Wait a few us for the pin to change- this is important!
   uint8_t portTemp = PINB;  // Cache the pins status...
@@ -49,6 +67,7 @@ int main(void)
     display = SMALL;  // If the pin is low, it's a small display.
   }
   PORTB &= ~0x08; // Disable the pull-up on PB3.
+#endif
   
   // ioInit() configures the IO pins as we'll need them for the rest of the
   //  code; once we've identified our display size, we'll do the pins
@@ -64,6 +83,9 @@ int main(void)
   //  check the EEPROM for a different speed.
   serialInit(BR115200);
   
+  // Flow control has to be set up before the first byte can arrive.
+  flowControl = getFlowControl();
+  
   // Enable interrupts. The only thing we use interrupts for is serial data.
   sei();
   
@@ -83,6 +105,7 @@ int main(void)
   
   // Draw the splash, if the EEPROM value says we should.
   if ((getSplash() & 0x01)==1) lcdDrawLogo();
+  lcdFlush();
   
   // Now wait for one second, for the user to override the stored baud rate
   //  and get back to 115200, if they so desire.
@@ -90,32 +113,7 @@ int main(void)
   
   // If the user has send *any* character during the splash time, we should
   //  skip this switch and set our baud rate back to 115200.
-  if (bufferSize == 0)
-  {
-    switch(getBaudRate())
-    {
-      case '1':
-      serialInit(BR4800);
-      break;
-      case '2':
-      serialInit(BR9600);
-      break;
-      case '3':
-      serialInit(BR19200);
-      break;
-      case '4':
-      serialInit(BR38400);
-      break;
-      case '5':
-      serialInit(BR57600);
-      break;
-      case '6':
-      serialInit(BR115200);
-      break;
-      default:
-      break;
-    }
-  }
+  if (serialBufferCount() == 0) serialSetBaud(getBaudRate());
   else setBaudRate('6');
   
   // Clear off the splash.
@@ -133,34 +131,21 @@ int main(void)
   
   // Under normal circumstances, we'll spend *all* our time cycling through
   //  this loop, parsing input from the serial port. The serial data is
-  //  buffered by an interrupt, and we'll pop that buffer here (and in ui.c)
-  //  and make decisions on what to do with it.
+  //  buffered by an interrupt, and uiStateMachine() (in ui.c) pops that
+  //  buffer and makes decisions on what to do with it. It returns as soon as
+  //  it runs out of data, even partway through a command, so we get a look
+  //  in between bytes.
   while(1)
   {
-    // If there's *anything* in the buffer, we need to deal with it.
-    while (bufferSize > 0)
-    {
-      // serialBufferPop() pulls data from the top of the FIFO that comprises
-      //  our serial port buffer, automatically changing the pointers and
-      //  stack size.
-      char bufferChar = serialBufferPop();
-      // If the character received is the command escape character ('|')...
-      if (bufferChar == '|')
-      {
-        while (bufferSize == 0);    // ...wait for the next character...
-        bufferChar = serialBufferPop(); // ...fetch the character..
-        uiStateMachine(bufferChar); // ... then see what to do.
-        // Note that we won't return from the state machine until the command
-        //  specified by the character that sends us there has been completed-
-        //  there's no bailing out of that process. Yet.
-      }
-      // Otherwise, draw the character. lcdDrawChar also handles backspace,
-      //   carriage return and new line.
-      else if (((bufferChar >= ' ') && (bufferChar <= '~')) ||
-               (bufferChar == '\r') ||  // Newline.
-               (bufferChar == '\b') )   // Backspace.
-        lcdDrawChar(bufferChar);
-    }
+    uiStateMachine();
+    // We've caught up with the host; push anything that's only been drawn
+    //  into the shadow framebuffer out to the glass.
+    lcdFlush();
+#ifdef HOST_BUILD
+    // On a PC, there's no host on the other end of the serial port; this is
+    //  where the simulator sends us more data, or stops us (see host/sim.c).
+    simIdle();
+#endif
   }
 }
 
@@ -14,7 +14,36 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 #ifndef __glcdbp_h
 #define __glcdbp_h
 
-#define BUF_DEPTH 256 // Ring buffer size. Originally set to 416.
+#define BUF_DEPTH 256 // Ring buffer size. Originally set to 416. It has to be
+                      //  a power of two no bigger than 256, so the 8-bit
+                      //  head and tail indices can just roll over.
+#define BUF_MASK  (BUF_DEPTH-1)
+#if (BUF_DEPTH > 256) || (BUF_DEPTH & BUF_MASK)
+#error "BUF_DEPTH must be a power of two, no more than 256"
+#endif
+
+// Flow control watermarks for the ring buffer. When the buffer fills up to
+//  RX_HIGH_WATER bytes, we tell the host to stop sending (if flow control is
+//  enabled- see the CTRL-w command); once we've worked it back down to
+//  RX_LOW_WATER, we tell it to go again. The gap between the high water mark
+//  and BUF_DEPTH is how many bytes the host can send after it's been told to
+//  stop without losing anything.
+#define RX_HIGH_WATER 192
+#define RX_LOW_WATER  64
+#if RX_HIGH_WATER >= BUF_DEPTH
+#error "RX_HIGH_WATER has to leave some room in the buffer"
+#endif
+
+// Outgoing bytes wait in a ring buffer of their own, which the USART's data
+//  register empty interrupt drains. Replies to the host are short (the
+//  longest is the benchmark's 9 bytes), so it doesn't need to be big; it
+//  just needs to hold a whole reply, so the main loop can get back to
+//  drawing while it goes out. Same rules as BUF_DEPTH.
+#define TX_DEPTH  32
+#define TX_MASK   (TX_DEPTH-1)
+#if (TX_DEPTH > 256) || (TX_DEPTH & TX_MASK)
+#error "TX_DEPTH must be a power of two, no more than 256"
+#endif
 
 // These typedefs will be used throughout the project to track the type of
 //  display we're using as well as whether we want the pixel(s) at the heart
@@ -22,6 +51,73 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 typedef enum DISPLAY_TYPE {SMALL, LARGE} DISPLAY_TYPE;
 typedef enum PIX_VAL {ON, OFF} PIX_VAL;
 
+// Each display driver describes itself to lcd.c with one of these, and lcd.c
+//  does all its drawing through it; nothing else in the project talks to a
+//  driver directly. A driver only has to know how to move bytes in and out
+//  of its own display memory- lines, text, sprites and the rest are lcd.c's
+//  problem. Display memory comes in two shapes:
+//   LAYOUT_COLUMNS - ks0108b style. A byte is 8 pixels stacked down a column,
+//                    bit 0 at the top; a "line" of bytes is a page 8 pixels
+//                    tall.
+//   LAYOUT_ROWS    - t6963 style. A byte is 8 pixels across a row, bit 7 on
+//                    the left; a line of bytes is one pixel row.
+//  Everything takes pixel coordinates, and means "the byte (or line of bytes)
+//  holding that pixel". Data going in is logical (a set bit is ON) and the
+//  driver takes care of reverse mode; data coming back out of readBytes is
+//  just what's in display memory.
+#define LAYOUT_COLUMNS 0
+#define LAYOUT_ROWS    1
+
+typedef struct LCD_DRIVER
+{
+  uint8_t width;      // Geometry, in pixels.
+  uint8_t height;
+  uint8_t layout;     // LAYOUT_COLUMNS or LAYOUT_ROWS.
+  void    (*init)(void);  // Get the controller up and running.
+  void    (*clear)(void); // Fill the screen with OFF pixels.
+  void    (*flush)(void); // Push out anything held back; 0 if nothing ever is.
+  // Read n bytes of display memory, starting with the one holding (x, y) and
+  //  carrying on along its line.
+  void    (*readBytes)(uint8_t x, uint8_t y, uint8_t *dst, uint8_t n);
+  // Turn bits of the byte holding (x, y) ON (set) or OFF (clear), leaving the
+  //  others alone. This is the controller's bit set/reset, if it has one.
+  void    (*writeBits)(uint8_t x, uint8_t y, uint8_t set, uint8_t clear);
+  // Write a run of width pixels, starting at (x, y), in one burst. src is in
+  //  the display's own byte format: one byte per column for LAYOUT_COLUMNS
+  //  (the whole line gets written), 8 pixels per byte for LAYOUT_ROWS.
+  void    (*writeRun)(uint8_t x, uint8_t y, uint8_t width, const uint8_t *src);
+  // Same, but every pixel is 'pixel'.
+  void    (*fillRun)(uint8_t x, uint8_t y, uint8_t width, PIX_VAL pixel);
+  // The 8x8 block read the sprites use; see lcdGetDataBlock().
+  void    (*readBlock)(uint8_t x, uint8_t y, uint8_t *buffer);
+  // The built-in text layer, if the controller has one; 0 if it doesn't.
+  void    (*textMode)(uint8_t mode);
+  void    (*clearText)(void);
+  void    (*writeText)(uint8_t col, uint8_t row, char printMe);
+  // Hardware scrolling, if the controller can do it; 0 if it can't. Moves
+  //  everything on the screen up 8 pixels (one line of text) and blanks the
+  //  line that comes in at the bottom. Afterwards, coordinates are for the
+  //  screen as it is now, so nothing above the driver needs to know.
+  //  scrollText does the same for the text layer, a row of cells at a time.
+  void    (*scroll)(void);
+  void    (*scrollText)(void);
+} LCD_DRIVER;
+
+// Normally, we figure out which display we've got at power up, and every
+//  drawing function checks 'display' to pick a driver. A build for just one
+//  kind of display (see DISPLAY_ONLY in the Makefile) turns 'display' into a
+//  constant instead, so the compiler can throw away the checks and all the
+//  code for the other display, and the other driver isn't built at all.
+#if defined(ONLY_KS0108B)
+#define DISPLAY_FIXED
+#define display SMALL
+#elif defined(ONLY_T6963)
+#define DISPLAY_FIXED
+#define display LARGE
+#else
+extern enum DISPLAY_TYPE display;
+#endif
+
 void timerInit(void);
 
 #endif
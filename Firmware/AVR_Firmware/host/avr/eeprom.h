@@ -0,0 +1,22 @@
+/***************************************************************************
+avr/eeprom.h (host build)
+
+Stand-in for avr-libc's <avr/eeprom.h>. The EEPROM lives in host/sim.c and
+ starts out the way a freshly programmed part does: all 0xff.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __host_avr_eeprom_h
+#define __host_avr_eeprom_h
+
+#include <stdint.h>
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+void    eeprom_write_byte(uint8_t *address, uint8_t value);
+void    eeprom_update_byte(uint8_t *address, uint8_t value);
+
+#endif
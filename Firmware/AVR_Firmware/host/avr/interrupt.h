@@ -0,0 +1,29 @@
+/***************************************************************************
+avr/interrupt.h (host build)
+
+Stand-in for avr-libc's <avr/interrupt.h>. An interrupt handler is just a
+ function the simulator calls, and the global interrupt enable is just a
+ flag it checks before doing so.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __host_avr_interrupt_h
+#define __host_avr_interrupt_h
+
+#include <avr/io.h>
+
+extern volatile uint8_t simInterrupts;  // The I bit in SREG, more or less.
+
+#define sei() (simInterrupts = 1)
+#define cli() (simInterrupts = 0)
+#define ISR(vector) void vector(void)
+
+void USART_RX_vect(void);
+void USART_UDRE_vect(void);
+void TIMER2_OVF_vect(void);
+
+#endif
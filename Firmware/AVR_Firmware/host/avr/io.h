@@ -0,0 +1,95 @@
+/***************************************************************************
+avr/io.h (host build)
+
+Stand-in for avr-libc's <avr/io.h> when the firmware is built to run on a
+ PC (see host/sim.c). The I/O registers the firmware touches are ordinary
+ variables here; the simulator looks at them to see what the firmware is
+ doing to the display bus, and fills in the PIN registers with what the
+ display would have put back.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __host_avr_io_h
+#define __host_avr_io_h
+
+#include <stdint.h>
+
+// Ports. The display bus lives on these.
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRB, DDRC, DDRD;
+extern volatile uint8_t PINB, PINC, PIND;
+
+// USART0. Writing UDR0 sends a byte and reading it fetches the last one
+//  received, so the simulator needs to tell those apart. UDR0 is really 16
+//  bits wide here: the simulator leaves the received byte in it with bit 8
+//  set, and a write from the firmware clears bit 8. Both UDR0 and UCSR0A are
+//  function calls, so the simulator gets a look (and collects anything that
+//  was sent) every time the firmware touches either one.
+volatile uint16_t *simUDR0(void);
+volatile uint8_t  *simUCSR0A(void);
+#define UDR0   (*simUDR0())
+#define UCSR0A (*simUCSR0A())
+extern volatile uint16_t UBRR0;
+extern volatile uint8_t  UCSR0B, UCSR0C;
+
+// Timers. Nothing models these; they're just somewhere to put the values.
+extern volatile uint8_t  TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+extern volatile uint8_t  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+extern volatile uint8_t  TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2, TIFR2;
+extern volatile uint8_t  ASSR, GTCCR;
+extern volatile uint8_t  SREG, MCUSR;
+
+// Bit numbers, straight out of the ATmega168 datasheet.
+#define RXC0    7
+#define TXC0    6
+#define UDRE0   5
+#define FE0     4
+#define DOR0    3
+#define UPE0    2
+#define U2X0    1
+#define MPCM0   0
+#define RXCIE0  7
+#define TXCIE0  6
+#define UDRIE0  5
+#define RXEN0   4
+#define TXEN0   3
+#define UCSZ02  2
+#define UCSZ01  2
+#define UCSZ00  1
+
+#define WGM21   1
+#define WGM20   0
+#define WGM22   3
+#define CS22    2
+#define CS21    1
+#define CS20    0
+#define OCIE2B  2
+#define OCIE2A  1
+#define TOIE2   0
+#define OCF2B   2
+#define OCF2A   1
+#define TOV2    0
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+
+// The main loop calls this when it's caught up with the serial port; see
+//  glcdbp.c and host/sim.c.
+void simIdle(void);
+
+#endif
@@ -0,0 +1,28 @@
+/***************************************************************************
+avr/pgmspace.h (host build)
+
+Stand-in for avr-libc's <avr/pgmspace.h>. On a PC, flash and RAM are the
+ same thing, so reading "program memory" is just reading memory.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __host_avr_pgmspace_h
+#define __host_avr_pgmspace_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P             const char *
+#define PSTR(s)           (s)
+#define pgm_read_byte(a)  (*(const uint8_t *)(a))
+#define pgm_read_word(a)  (*(a))  // Also used for function pointers, which
+                                  //  are a lot wider than 16 bits here.
+#define memcpy_P          memcpy
+#define strcpy_P          strcpy
+
+#endif
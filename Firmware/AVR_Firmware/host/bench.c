@@ -0,0 +1,328 @@
+/***************************************************************************
+bench.c
+
+The host build's benchmark: a fixed set of drawing jobs, run straight
+ through lcd.c (no serial port, no command parser) so the cost model in
+ cost.c has nothing to look at but the drawing. See sim.h. The check suite
+ lives here too; it drives lcd.c the same way, but it's after the right
+ picture, not a fast one.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#include <string.h>
+#include "sim.h"
+#include "../glcdbp.h"
+#include "../io_support.h"
+#include "../lcd.h"
+#include "../ks0108b.h"
+#include "../serial.h"
+#include "../ui.h"
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+
+extern volatile uint8_t reverse; // This is defined in glcdbp.c
+extern uint8_t cursorPos[];      // And this in lcd.c.
+
+// The "random" lines and pixels have to be the same every run, or the
+//  numbers won't compare, so we bring our own generator rather than trust
+//  the C library's.
+static uint32_t benchSeed = 1;
+
+static uint8_t benchRandom(uint8_t limit)
+{
+  benchSeed = benchSeed * 1103515245 + 12345;
+  return ((benchSeed >> 16) & 0x7fff) % limit;
+}
+
+// Just enough of main() to get the display going.
+static void benchStart(uint8_t large)
+{
+  display = large ? LARGE : SMALL;
+  reverse = 0;
+  ioInit();
+  lcdConfig();
+}
+
+void simBenchmark(uint8_t large)
+{
+  uint8_t width = large ? 160 : 128;
+  uint8_t height = large ? 128 : 64;
+
+  benchStart(large);
+
+  // Each job ends with a flush, so anything a shadow framebuffer is holding
+  //  back gets paid for before the next one starts.
+  lcdClearScreen();
+  lcdFlush();
+
+  for (uint8_t i = 0; i < 100; i++) lcdDrawChar(' ' + 1 + (i % 94));
+  lcdFlush();
+
+  for (uint8_t i = 0; i < 50; i++)
+  {
+    uint8_t x0 = benchRandom(width);
+    uint8_t y0 = benchRandom(height);
+    uint8_t x1 = benchRandom(width);
+    uint8_t y1 = benchRandom(height);
+    lcdDrawLine(x0, y0, x1, y1, ON);
+  }
+  lcdFlush();
+
+  for (uint8_t r = 5; r <= 60; r++)
+  {
+    lcdDrawCircle(width/2, height/2, r, (r & 0x01) ? ON : OFF);
+  }
+  lcdFlush();
+
+  for (uint8_t i = 0; i < 20; i++)
+  {
+    lcdDrawSprite((i * 13) % (width - 8), (i * 7) % (height - 8), i, '0', ON);
+  }
+  lcdFlush();
+
+  lcdEraseBlock(0, 0, width-1, height-1);
+  lcdFlush();
+
+  // ks0108bDrawPixel() is the old per-pixel path; lcd.c doesn't use it any
+  //  more, but it's still the yardstick for a single read-modify-write.
+  if (!large)
+  {
+    for (uint8_t i = 0; i < 100; i++)
+    {
+      ks0108bDrawPixel(benchRandom(width), benchRandom(height), ON);
+    }
+    lcdFlush();
+  }
+}
+
+// The clip rectangles the checks draw through: a box in the middle, one
+//  hanging off the top left, and one off the bottom right, which is mostly
+//  off the small display.
+static const uint8_t checkClips[][4] =
+{
+  {30, 20, 100, 50},
+  {0, 0, 40, 25},
+  {90, 40, 255, 255}
+};
+
+#define CHECK_CLIPS (sizeof(checkClips)/sizeof(checkClips[0]))
+
+static uint8_t checkWidth, checkHeight;
+static uint8_t checkFull[160*128];  // What it looks like without clipping.
+
+static void checkCapture(uint8_t *image)
+{
+  lcdFlush();
+  for (uint8_t y = 0; y < checkHeight; y++)
+  {
+    for (uint8_t x = 0; x < checkWidth; x++)
+    {
+      image[y*checkWidth + x] = simPixel(x, y);
+    }
+  }
+}
+
+// What's on the glass now should be checkFull, cut down to the clip
+//  rectangle. Returns how many pixels aren't.
+static uint32_t checkClipped(const uint8_t *clip)
+{
+  uint32_t wrong = 0;
+  lcdFlush();
+  for (uint8_t y = 0; y < checkHeight; y++)
+  {
+    for (uint8_t x = 0; x < checkWidth; x++)
+    {
+      uint8_t inside = (x >= clip[0]) && (x <= clip[2]) &&
+                       (y >= clip[1]) && (y <= clip[3]);
+      uint8_t expect = inside ? checkFull[y*checkWidth + x] : 0;
+      if (simPixel(x, y) != expect) wrong++;
+    }
+  }
+  return wrong;
+}
+
+// Big circles, centered all over the place (on and off the screen), through
+//  each clip rectangle. lcdDrawCircle() skips the octants that can't reach
+//  the clip rectangle, and radii past 181 are where its arithmetic needs all
+//  16 bits of an AVR int; this makes sure it never skips one it needs.
+static void checkCircles(void)
+{
+  static const uint8_t centers[][2] =
+    {{0, 0}, {64, 32}, {80, 64}, {159, 0}, {0, 127}, {255, 255}, {255, 0},
+     {0, 255}, {200, 100}};
+  for (uint8_t i = 0; i < CHECK_CLIPS; i++)
+  {
+    const uint8_t *clip = checkClips[i];
+    for (uint16_t r = 150; r <= 255; r++)
+    {
+      for (uint8_t j = 0; j < sizeof(centers)/sizeof(centers[0]); j++)
+      {
+        uint8_t x0 = centers[j][0], y0 = centers[j][1];
+        lcdSetClip(0, 0, 255, 255);
+        lcdClearScreen();
+        lcdDrawCircle(x0, y0, r, ON);
+        checkCapture(checkFull);
+        lcdClearScreen();
+        lcdSetClip(clip[0], clip[1], clip[2], clip[3]);
+        lcdDrawCircle(x0, y0, r, ON);
+        uint32_t wrong = checkClipped(clip);
+        if (wrong) simError("check: circle at (%u, %u), radius %u, clipped to "
+                            "(%u, %u)-(%u, %u): %u pixels wrong", x0, y0, r,
+                            clip[0], clip[1], clip[2], clip[3], wrong);
+      }
+    }
+  }
+}
+
+// Fill the screen with text, starting a few pixels in from the corner.
+static void checkTextFill(uint8_t xStart, uint8_t yStart)
+{
+  char c = '!';
+  for (uint8_t y = yStart; y <= checkHeight - 8; y += 8)
+  {
+    for (uint8_t x = xStart; x <= checkWidth - 6; x += 6)
+    {
+      cursorPos[0] = x;
+      cursorPos[1] = y;
+      lcdDrawChar(c);
+      if (++c > '~') c = '!';
+    }
+  }
+}
+
+// Text through each clip rectangle, with the characters at a few different
+//  offsets, so the rectangle's edges cut through them in different places.
+static void checkText(void)
+{
+  static const uint8_t starts[][2] = {{0, 0}, {1, 3}, {3, 7}, {5, 1}};
+  for (uint8_t i = 0; i < CHECK_CLIPS; i++)
+  {
+    const uint8_t *clip = checkClips[i];
+    for (uint8_t j = 0; j < sizeof(starts)/sizeof(starts[0]); j++)
+    {
+      lcdSetClip(0, 0, 255, 255);
+      lcdClearScreen();
+      checkTextFill(starts[j][0], starts[j][1]);
+      checkCapture(checkFull);
+      lcdClearScreen();
+      lcdSetClip(clip[0], clip[1], clip[2], clip[3]);
+      checkTextFill(starts[j][0], starts[j][1]);
+      uint32_t wrong = checkClipped(clip);
+      if (wrong) simError("check: text from (%u, %u), clipped to "
+                          "(%u, %u)-(%u, %u): %u pixels wrong", starts[j][0],
+                          starts[j][1], clip[0], clip[1], clip[2], clip[3],
+                          wrong);
+    }
+  }
+}
+
+// Send some text to the command parser, and draw whatever it draws. Returns
+//  how many NAKs came back.
+static uint8_t checkParse(const uint8_t *data, uint16_t n)
+{
+  uint8_t reply[64];
+  uint8_t naks = 0;
+  cursorPos[0] = 0;
+  cursorPos[1] = 0;
+  lcdClearScreen();
+  simSend(data, n);
+  uiStateMachine();
+  for (uint8_t i = simSent(reply, sizeof(reply)); i > 0; i--)
+  {
+    if (reply[i-1] == NAK) naks++;
+  }
+  return naks;
+}
+
+// "\r\n" line endings have to come out the same in a frame as out of one:
+//  the line feed is ignored either way, and never taken for a command. Acks
+//  are on, so a line feed that got NAKed would show.
+static void checkLineFeed(void)
+{
+  static const uint8_t text[] = "ab\r\ncd\r\n";
+  uint8_t input[64];
+  uint8_t n = 0;
+  checkParse(text, sizeof(text) - 1);
+  checkCapture(checkFull);
+
+  input[n++] = '|';
+  input[n++] = ACK_MODE;
+  input[n++] = 0x01;
+  input[n++] = '|';
+  input[n++] = FRAME_MODE;
+  uint8_t start = n;
+  input[n++] = sizeof(text) - 1;
+  memcpy(&input[n], text, sizeof(text) - 1);
+  n += sizeof(text) - 1;
+  uint8_t crc = 0;
+  for (uint8_t i = start; i < n; i++) crc = _crc8_ccitt_update(crc, input[i]);
+  input[n++] = crc;
+  input[n++] = 0x00;      // Back out of framed mode...
+  input[n++] = '|';
+  input[n++] = ACK_MODE;  // ...and turn the acks off again.
+  input[n++] = 0x00;
+  uint8_t naks = checkParse(input, n);
+  static const uint8_t wholeScreen[4] = {0, 0, 255, 255};
+  uint32_t wrong = checkClipped(wholeScreen);
+  if (naks) simError("check: line feeds in a frame got %u NAKs", naks);
+  if (wrong) simError("check: \"\\r\\n\" text in a frame came out "
+                      "different: %u pixels wrong", wrong);
+}
+
+// A CTRL-u with a bad mode gets one NAK, and its image is thrown away- not
+//  drawn, and not read as text and commands either. The image here is a
+//  literal run of letters, which would show up on the screen if it were.
+static void checkBadUpdate(void)
+{
+  static const uint8_t input[] =
+    {'|', ACK_MODE, 0x01,
+     '|', UPDATE, 0, 0, 8, 8, 0x02, 0x07, 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
+     '|', ACK_MODE, 0x00};
+  static const uint8_t wholeScreen[4] = {0, 0, 255, 255};
+  memset(checkFull, 0, sizeof(checkFull));
+  uint8_t naks = checkParse(input, sizeof(input));
+  uint32_t wrong = checkClipped(wholeScreen);
+  if (naks != 1) simError("check: CTRL-u with a bad mode got %u NAKs", naks);
+  if (wrong) simError("check: CTRL-u with a bad mode drew %u pixels", wrong);
+}
+
+// Right after a scroll, before anybody flushes, the line that came in at the
+//  bottom of the glass has to be blank already; the start line doesn't wait
+//  for a shadow framebuffer.
+static void checkScroll(void)
+{
+  lcdClearScreen();
+  lcdFillRect(0, 0, checkWidth-1, checkHeight-1, ON);
+  lcdFlush();
+  ks0108bScroll();
+  uint32_t wrong = 0;
+  for (uint8_t y = checkHeight-8; y < checkHeight; y++)
+  {
+    for (uint8_t x = 0; x < checkWidth; x++)
+    {
+      if (simPixel(x, y)) wrong++;
+    }
+  }
+  if (wrong) simError("check: scrolled-in line has %u pixels still on",
+                      wrong);
+  lcdClearScreen();
+}
+
+void simCheck(uint8_t large)
+{
+  checkWidth = large ? 160 : 128;
+  checkHeight = large ? 128 : 64;
+  benchStart(large);
+  checkCircles();
+  checkText();
+  lcdSetClip(0, 0, 255, 255);
+  if (!large) checkScroll();
+  serialInit(BR115200);
+  sei();
+  checkLineFeed();
+  checkBadUpdate();
+}
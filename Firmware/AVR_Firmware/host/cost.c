@@ -0,0 +1,216 @@
+/***************************************************************************
+cost.c
+
+The host build's cost model: who spent all that time on the bus? See sim.h.
+
+The firmware is compiled with -finstrument-functions, so gcc calls
+ __cyg_profile_func_enter() and __cyg_profile_func_exit() (below) around
+ every one of its functions. We look out for the public lcd.c calls, and
+ for the ones that are running, charge them for every strobe, address
+ command, dummy read, status poll and nanosecond of delay the bus models
+ and simDelay() report.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "../glcdbp.h"
+#include "../lcd.h"
+#include "../ks0108b.h"
+#include "../t6963.h"
+
+// There are two groups of functions we keep track of: the public lcd.c calls
+//  (group 0) and a few driver functions that are worth watching on their own
+//  (group 1). Within a group, only the outermost call gets charged, so
+//  lcdDrawBox() pays for the lcdDrawLine() calls it makes, and the group 0
+//  column adds up to the whole run. Groups don't affect each other; a driver
+//  function's costs show up in both tables.
+#define COST_LCD    0
+#define COST_DRIVER 1
+#define COST_GROUPS 2
+
+typedef struct COST
+{
+  void        *function;
+  const char  *name;
+  uint8_t     group;
+  uint32_t    depth;      // How deep in calls to this function are we?
+  uint32_t    calls;      // Outermost calls only.
+  uint64_t    count[SIM_COUNTERS];
+} COST;
+
+#define COST_ENTRY(f, group) {(void *)(f), #f, group, 0, 0, {0}}
+
+static COST costs[] =
+{
+  // Whatever happens outside any lcd.c call- start-up, the serial port, the
+  //  menus- gets charged to this one.
+  {0, "(other)", COST_LCD, 0, 0, {0}},
+  COST_ENTRY(lcdConfig, COST_LCD),
+  COST_ENTRY(lcdClearScreen, COST_LCD),
+  COST_ENTRY(lcdDrawPixel, COST_LCD),
+  COST_ENTRY(lcdDrawLine, COST_LCD),
+  COST_ENTRY(lcdDrawCircle, COST_LCD),
+  COST_ENTRY(lcdDrawBox, COST_LCD),
+  COST_ENTRY(lcdDrawChar, COST_LCD),
+  COST_ENTRY(lcdDrawLogo, COST_LCD),
+  COST_ENTRY(lcdEraseBlock, COST_LCD),
+  COST_ENTRY(lcdFillRect, COST_LCD),
+  COST_ENTRY(lcdGetDataBlock, COST_LCD),
+  COST_ENTRY(lcdDrawSprite, COST_LCD),
+  COST_ENTRY(lcdFlush, COST_LCD),
+  COST_ENTRY(lcdSetClip, COST_LCD),
+  COST_ENTRY(lcdSetTextLayer, COST_LCD),
+  COST_ENTRY(lcdDrawColumns, COST_LCD),
+  COST_ENTRY(lcdBlitBegin, COST_LCD),
+  COST_ENTRY(lcdBlitWrite, COST_LCD),
+  COST_ENTRY(ks0108bDrawPixel, COST_DRIVER),
+  COST_ENTRY(t6963DrawPixel, COST_DRIVER),
+};
+
+#define COST_COUNT (sizeof(costs)/sizeof(costs[0]))
+
+static COST *current[COST_GROUPS] = {&costs[0], 0};
+
+static const char *counterNames[SIM_COUNTERS] =
+  {"strobes", "page", "column", "pointer", "dummy", "polls", "delay ms"};
+
+void __cyg_profile_func_enter(void *function, void *site)
+  __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void *function, void *site)
+  __attribute__((no_instrument_function));
+
+static COST *costFind(void *function) __attribute__((no_instrument_function));
+static COST *costFind(void *function)
+{
+  for (uint8_t i = 1; i < COST_COUNT; i++)
+  {
+    if (costs[i].function == function) return &costs[i];
+  }
+  return 0;
+}
+
+void __cyg_profile_func_enter(void *function, void *site)
+{
+  COST *c = costFind(function);
+  if (c == 0) return;
+  if (c->depth++ != 0) return;
+  // Outermost in its group? Then it's the one paying, until it returns.
+  COST *now = current[c->group];
+  if ((now == 0) || (now == &costs[0]))
+  {
+    current[c->group] = c;
+    c->calls++;
+  }
+}
+
+void __cyg_profile_func_exit(void *function, void *site)
+{
+  COST *c = costFind(function);
+  if ((c == 0) || (c->depth == 0)) return;
+  if ((--c->depth == 0) && (current[c->group] == c))
+  {
+    current[c->group] = (c->group == COST_LCD) ? &costs[0] : 0;
+  }
+}
+
+void simCount(uint8_t counter, uint32_t n)
+{
+  for (uint8_t g = 0; g < COST_GROUPS; g++)
+  {
+    if (current[g]) current[g]->count[counter] += n;
+  }
+}
+
+// What this would have taken on the real thing: the delays, plus our guess
+//  at the code around each strobe.
+static double costEstimateMs(const COST *c)
+{
+  return (c->count[SIM_DELAY_NS] +
+          c->count[SIM_STROBES] * SIM_CYCLES_PER_STROBE * 1e9 / F_CPU) / 1e6;
+}
+
+static double costPerCallUs(const COST *c)
+{
+  if (c->calls == 0) return 0;
+  return costEstimateMs(c) * 1000 / c->calls;
+}
+
+void simCostReport(FILE *out, const char *title)
+{
+  fprintf(out, "%s\n", title);
+  for (uint8_t g = 0; g < COST_GROUPS; g++)
+  {
+    fprintf(out, "\n%-18s %7s", (g == COST_LCD) ? "lcd.c call" : "driver call",
+            "calls");
+    for (uint8_t i = 0; i < SIM_COUNTERS; i++)
+    {
+      fprintf(out, " %9s", counterNames[i]);
+    }
+    fprintf(out, " %9s %9s\n", "est ms", "us/call");
+    for (uint8_t i = 0; i < COST_COUNT; i++)
+    {
+      COST *c = &costs[i];
+      if ((c->group != g) || ((c->calls == 0) && (i != 0))) continue;
+      fprintf(out, "%-18s %7u", c->name, c->calls);
+      for (uint8_t j = 0; j < SIM_DELAY_NS; j++)
+      {
+        fprintf(out, " %9llu", (unsigned long long)c->count[j]);
+      }
+      fprintf(out, " %9.3f %9.3f %9.1f\n", c->count[SIM_DELAY_NS] / 1e6,
+              costEstimateMs(c), costPerCallUs(c));
+    }
+  }
+}
+
+// Hold this run up against a list of limits. Each line of the baseline file
+//  is a display name, a function name and the estimated microseconds per
+//  call that it's allowed; anything that's gotten more than SLACK slower than
+//  that, or wasn't called at all, is a regression. Lines for the other
+//  display and lines starting with '#' are skipped. Returns the number of
+//  regressions.
+#define COST_SLACK 1.02
+
+uint8_t simCostCheck(const char *modelName, const char *baselineName)
+{
+  FILE *f = fopen(baselineName, "r");
+  char line[128], model[32], name[32];
+  double limit;
+  uint8_t regressions = 0;
+  if (f == 0)
+  {
+    perror(baselineName);
+    return 1;
+  }
+  while (fgets(line, sizeof(line), f))
+  {
+    if ((line[0] == '#') ||
+        (sscanf(line, "%31s %31s %lf", model, name, &limit) != 3)) continue;
+    if (strcmp(model, modelName) != 0) continue;
+    COST *c = 0;
+    for (uint8_t i = 0; i < COST_COUNT; i++)
+    {
+      if (strcmp(costs[i].name, name) == 0) c = &costs[i];
+    }
+    if ((c == 0) || (c->calls == 0))
+    {
+      fprintf(stderr, "%s: %s never ran\n", modelName, name);
+      regressions++;
+    }
+    else if (costPerCallUs(c) > limit * COST_SLACK)
+    {
+      fprintf(stderr, "%s: %s takes %.1f us per call; the baseline is %.1f\n",
+              modelName, name, costPerCallUs(c), limit);
+      regressions++;
+    }
+    else printf("%s: %s %.1f us per call (baseline %.1f)\n", modelName, name,
+                costPerCallUs(c), limit);
+  }
+  fclose(f);
+  return regressions;
+}
@@ -0,0 +1,497 @@
+/***************************************************************************
+sim.c
+
+The host build's simulator: everything on the far side of the AVR's pins.
+ Runs the firmware's own main() with a display bus model hanging off the
+ I/O registers and a file of serial input to chew on, then dumps the glass
+ as a PBM image. See sim.h.
+
+ Usage: gLCD_ser_bp_host [-l] [-c] [-o screen.pbm] [-t sent.bin] [input]
+        gLCD_ser_bp_host [-l] -b [-r baseline.txt] [-o screen.pbm]
+        gLCD_ser_bp_host [-l] -k [-o screen.pbm]
+   -l  simulate the large (t6963) display; the default is the small one.
+   -c  print what each lcd.c call cost on the bus, when we're done.
+   -o  where to write the screen image. Default: screen.pbm.
+   -t  where to write whatever the firmware sends back over the serial port.
+   input is the serial data to send; standard input if there isn't any.
+   -b  run the benchmark suite (host/bench.c) instead of the firmware, and
+       print the costs.
+   -r  check the benchmark against a baseline file, and fail if anything in
+       it has gotten slower. See simCostCheck() in host/cost.c.
+   -k  run the check suite (host/bench.c) instead of the firmware, and fail
+       if anything it draws comes out wrong.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include "sim.h"
+#include "../glcdbp.h"
+#include "../serial.h"
+#include "../io_support.h"
+
+// The registers. See host/avr/io.h.
+volatile uint8_t  PORTB, PORTC, PORTD;
+volatile uint8_t  DDRB, DDRC, DDRD;
+volatile uint8_t  PINB, PINC, PIND;
+volatile uint16_t UBRR0;
+volatile uint8_t  UCSR0B, UCSR0C;
+volatile uint8_t  TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+volatile uint8_t  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+volatile uint8_t  TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2, TIFR2;
+volatile uint8_t  ASSR, GTCCR;
+volatile uint8_t  SREG, MCUSR;
+volatile uint8_t  simInterrupts;
+static volatile uint8_t  ucsr0a = (1<<UDRE0);
+static volatile uint16_t udr0 = 0x100;  // See host/avr/io.h.
+
+static uint8_t eeprom[512];
+
+uint64_t simNow;
+static uint64_t delayTotal;    // Time spent in _delay_us() and friends.
+
+static const SIM_MODEL *model = &simKs0108b;
+static uint8_t  jumper;        // PB3: high for the large display.
+static uint32_t errors;
+static uint32_t contention;    // Samples where we and the display were both
+                               //  driving the data bus.
+
+// The host end of the serial port.
+static uint8_t  *input;
+static size_t   inputLength;
+static size_t   inputSent;
+static uint8_t  started;       // Has the firmware finished starting up?
+static uint64_t nextByte;      // When the next byte can go out.
+static uint8_t  held;          // A byte's waiting for interrupts to come on.
+static uint8_t  heldByte;
+static uint8_t  xoff;          // Has the firmware sent XOFF?
+static FILE     *txFile;
+static uint32_t txCount;
+static uint8_t  sent[64];      // The last few bytes sent, for simSent().
+static uint8_t  sentCount;
+
+static uint8_t  costReport;    // -c
+static uint8_t  benchmark;     // -b
+static uint8_t  check;         // -k
+static const char *baseline;   // -r
+
+// These live in glcdbp.c.
+extern uint8_t           flowControl;
+extern volatile uint16_t rxOverflows;
+extern volatile uint16_t rxOverruns;
+extern int firmwareMain(void);
+
+void simError(const char *format, ...)
+{
+  va_list ap;
+  // Past the first few, they're usually all the same thing.
+  if (errors++ < 20)
+  {
+    fprintf(stderr, "%.3f ms: ", simNow / 1e6);
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+  }
+}
+
+uint8_t eeprom_read_byte(const uint8_t *address)
+{
+  return eeprom[(uintptr_t)address & 0x1ff];
+}
+
+void eeprom_write_byte(uint8_t *address, uint8_t value)
+{
+  eeprom[(uintptr_t)address & 0x1ff] = value;
+}
+
+void eeprom_update_byte(uint8_t *address, uint8_t value)
+{
+  eeprom_write_byte(address, value);
+}
+
+// If the firmware has put a byte in UDR0 since we last looked, it's sent.
+//  What's left behind for reading is the last byte received.
+static uint8_t lastReceived;
+
+static void simTransmit(void)
+{
+  if (udr0 & 0x100) return;
+  uint8_t data = udr0;
+  udr0 = 0x100 | lastReceived;
+  txCount++;
+  if (sentCount < sizeof(sent)) sent[sentCount++] = data;
+  if (txFile) fputc(data, txFile);
+  if (flowControl & FLOW_XONXOFF)
+  {
+    if (data == XOFF) xoff = 1;
+    if (data == XON)  xoff = 0;
+  }
+}
+
+volatile uint16_t *simUDR0(void)
+{
+  simTransmit();
+  return &udr0;
+}
+
+// The transmitter is always ready; sending takes no time.
+volatile uint8_t *simUCSR0A(void)
+{
+  simTransmit();
+  ucsr0a |= (1<<UDRE0);
+  return &ucsr0a;
+}
+
+// How long a byte takes on the wire at the current baud rate. We always run
+//  the USART in double speed mode.
+static uint64_t simByteTime(void)
+{
+  return (uint64_t)10 * 8 * (UBRR0 + 1) * 1000000000ULL / F_CPU;
+}
+
+// A byte has arrived. If interrupts are on, it goes straight to the receive
+//  interrupt; if not, it waits in UDR0, and if another one shows up before
+//  it's collected, that's a data overrun.
+static void simReceive(uint8_t data)
+{
+  if ((UCSR0B & (1<<RXEN0)) == 0) return;
+  if (held)
+  {
+    ucsr0a |= (1<<DOR0);
+    return;
+  }
+  held = 1;
+  heldByte = data;
+}
+
+static void simInterrupt(void)
+{
+  if (!held || !simInterrupts || ((UCSR0B & (1<<RXCIE0)) == 0)) return;
+  simTransmit();
+  held = 0;
+  lastReceived = heldByte;
+  udr0 = 0x100 | heldByte;
+  ucsr0a |= (1<<RXC0);
+  simInterrupts = 0;
+  USART_RX_vect();
+  simInterrupts = 1;
+  ucsr0a &= ~((1<<RXC0) | (1<<DOR0));
+  simTransmit();
+}
+
+// The data register empty interrupt. The transmitter is always ready, so
+//  once the firmware turns this on, it runs (as soon as interrupts let it)
+//  until the firmware runs out of things to say and it turns itself off.
+//  Whatever it sends counts as sent right away; nothing else is going to
+//  touch UDR0 and push the last byte out for us.
+static void simTxInterrupt(void)
+{
+  while (simInterrupts && (UCSR0B & (1<<UDRIE0)))
+  {
+    simInterrupts = 0;
+    USART_UDRE_vect();
+    simInterrupts = 1;
+  }
+  simTransmit();
+}
+
+// For the check suite, which runs uiStateMachine() itself: put bytes
+//  through the receive interrupt as if they'd just arrived, and collect what
+//  the firmware has sent back since the last look.
+void simSend(const uint8_t *data, uint16_t n)
+{
+  while (n--)
+  {
+    simReceive(*data++);
+    simInterrupt();
+  }
+}
+
+uint8_t simSent(uint8_t *dst, uint8_t max)
+{
+  simTxInterrupt();
+  uint8_t n = (sentCount < max) ? sentCount : max;
+  memcpy(dst, sent, n);
+  sentCount = 0;
+  return n;
+}
+
+// Is the host allowed to send? It honors RTS and XON/XOFF, like a host with
+//  flow control turned on would.
+static uint8_t simClearToSend(void)
+{
+  if (xoff) return 0;
+  if ((DDRB & (1<<RTS)) && (PORTB & (1<<RTS))) return 0;
+  return 1;
+}
+
+// Send whatever the host would have sent by 'until'.
+static void simSerial(uint64_t until)
+{
+  while (started && (inputSent < inputLength))
+  {
+    if (!simClearToSend())
+    {
+      if (nextByte < simNow) nextByte = simNow;
+      break;
+    }
+    if (nextByte > until) break;
+    if (nextByte > simNow) simNow = nextByte;
+    simReceive(input[inputSent++]);
+    simInterrupt();
+    simTxInterrupt();  // So an XOFF stops the next byte.
+    nextByte = simNow + simByteTime();
+  }
+}
+
+// Look at the pins, let the display model do its thing, and put whatever it
+//  says is on the data bus onto the PIN registers.
+static void simSample(void)
+{
+  uint8_t data = (PORTB & 0x03) | (PORTD & 0xfc);
+  uint8_t dataOut = ((DDRB & 0x03) == 0x03) && ((DDRD & 0xfc) == 0xfc);
+  uint8_t in;
+  if (model->sample(PORTC, data, dataOut, &in))
+  {
+    if (dataOut) contention++;
+  }
+  else in = data;
+  PINB = (PORTB & ~0x0b) | (in & 0x03) | (jumper ? 0x08 : 0x00);
+  PINC = PORTC;
+  PIND = (PORTD & 0x03) | (in & 0xfc);
+}
+
+// Timer2, which the benchmark times things with. Normal mode and the
+//  overflow interrupt are all we do. The overflow flag is cleared by writing
+//  a 1 to it, which we can't see happen, so we keep the real flag here and
+//  copy it out to TIFR2; since we take the interrupt as soon as it can run,
+//  the flag's hardly ever set when the firmware goes to clear it.
+static uint64_t timer2Fraction;  // Clock cycles (times 1000) not yet ticked.
+static uint8_t  timer2Flag;
+
+static void simTimer2Interrupt(void)
+{
+  if (timer2Flag && (TIMSK2 & (1<<TOIE2)) && simInterrupts)
+  {
+    timer2Flag = 0;
+    simInterrupts = 0;
+    TIMER2_OVF_vect();
+    simInterrupts = 1;
+  }
+  TIFR2 = (TIFR2 & ~(1<<TOV2)) | (timer2Flag ? (1<<TOV2) : 0);
+}
+
+static void simTimer2(uint32_t ns)
+{
+  static const uint16_t prescale[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+  uint16_t divide = prescale[TCCR2B & 0x07];
+  if (divide == 0)
+  {
+    timer2Fraction = 0;
+    return;
+  }
+  timer2Fraction += (uint64_t)ns * (F_CPU / 1000000UL);
+  uint32_t ticks = timer2Fraction / (1000UL * divide);
+  timer2Fraction %= (1000UL * divide);
+  while (ticks--)
+  {
+    if (++TCNT2 == 0)
+    {
+      timer2Flag = 1;
+      simTimer2Interrupt();
+    }
+  }
+}
+
+void simDelay(uint32_t ns)
+{
+  simSample();
+  simInterrupt();
+  simTxInterrupt();
+  simTimer2Interrupt();
+  delayTotal += ns;
+  simCount(SIM_DELAY_NS, ns);
+  simSerial(simNow + ns);
+  simNow += ns;
+  simTimer2(ns);
+  simSample();
+}
+
+uint8_t simPixel(uint8_t x, uint8_t y)
+{
+  return model->pixel(x, y);
+}
+
+static void simFinish(const char *imageName)
+{
+  simTxInterrupt();
+  FILE *image = fopen(imageName, "wb");
+  if (image == 0)
+  {
+    perror(imageName);
+    exit(2);
+  }
+  // P4 is the packed kind of PBM: 8 pixels per byte, leftmost in bit 7, and
+  //  a 1 is black.
+  fprintf(image, "P4\n%d %d\n", model->width, model->height);
+  for (uint8_t y = 0; y < model->height; y++)
+  {
+    for (uint8_t x = 0; x < model->width; x += 8)
+    {
+      uint8_t bits = 0;
+      for (uint8_t i = 0; i < 8; i++)
+      {
+        if (model->pixel(x+i, y)) bits |= 0x80>>i;
+      }
+      fputc(bits, image);
+    }
+  }
+  fclose(image);
+  if (txFile) fclose(txFile);
+  fprintf(stderr, "%s: %zu bytes in, %u out, %.3f ms simulated "
+          "(%.3f ms of delays), %u overflows, %u overruns, "
+          "%u bus contentions, %u errors\n", model->name, inputSent,
+          txCount, simNow / 1e6, delayTotal / 1e6, rxOverflows, rxOverruns,
+          contention, errors);
+  if (costReport) simCostReport(stdout, model->name);
+  if (baseline && simCostCheck(model->name, baseline)) exit(1);
+  exit(errors ? 1 : 0);
+}
+
+static const char *imageName = "screen.pbm";
+
+// The main loop calls this when it's done everything it can with the data
+//  it's got. Nothing more is going to happen until the next byte arrives, so
+//  we skip straight to it- or, if there aren't any more, we're done. Bytes
+//  that arrived while the main loop was busy (flushing the shadow, say)
+//  haven't been looked at yet, though, so we're only done once a trip round
+//  the loop goes by with nothing new.
+void simIdle(void)
+{
+  static size_t sentAtIdle = 0;
+  if (!started)
+  {
+    started = 1;
+    nextByte = simNow;
+  }
+  simInterrupt();
+  simTxInterrupt();
+  if ((inputSent >= inputLength) && (inputSent == sentAtIdle))
+    simFinish(imageName);
+  sentAtIdle = inputSent;
+  if (!simClearToSend())
+  {
+    simError("stalled: the firmware is idle, but has told us to stop");
+    simFinish(imageName);
+  }
+  if (nextByte > simNow) simNow = nextByte;
+  simSerial(simNow);
+}
+
+// Read all of a file (or standard input) into memory.
+static uint8_t *simLoad(FILE *f, size_t *length)
+{
+  size_t size = 4096;
+  uint8_t *data = malloc(size);
+  *length = 0;
+  while (data)
+  {
+    *length += fread(data + *length, 1, size - *length, f);
+    if (*length < size) break;
+    size *= 2;
+    data = realloc(data, size);
+  }
+  return data;
+}
+
+int main(int argc, char **argv)
+{
+  int option;
+  while ((option = getopt(argc, argv, "lco:t:br:k")) != -1)
+  {
+    switch (option)
+    {
+      case 'l':
+      model = &simT6963;
+      jumper = 1;
+      break;
+      case 'c':
+      costReport = 1;
+      break;
+      case 'o':
+      imageName = optarg;
+      break;
+      case 'b':
+      benchmark = 1;
+      costReport = 1;
+      break;
+      case 'r':
+      baseline = optarg;
+      break;
+      case 'k':
+      check = 1;
+      break;
+      case 't':
+      txFile = fopen(optarg, "wb");
+      if (txFile == 0)
+      {
+        perror(optarg);
+        return 2;
+      }
+      break;
+      default:
+      fprintf(stderr, "usage: %s [-l] [-c] [-o screen.pbm] [-t sent.bin] "
+              "[input]\n       %s [-l] -b [-r baseline.txt] "
+              "[-o screen.pbm]\n       %s [-l] -k [-o screen.pbm]\n",
+              argv[0], argv[0], argv[0]);
+      return 2;
+    }
+  }
+
+  // A freshly programmed part: EEPROM all 0xff, pins all inputs and low.
+  memset(eeprom, 0xff, sizeof(eeprom));
+  model->reset();
+  simSample();
+
+  if (benchmark)
+  {
+    simBenchmark(jumper);
+    simFinish(imageName);
+  }
+
+  if (check)
+  {
+    simCheck(jumper);
+    simFinish(imageName);
+  }
+
+  FILE *in = stdin;
+  if (optind < argc)
+  {
+    in = fopen(argv[optind], "rb");
+    if (in == 0)
+    {
+      perror(argv[optind]);
+      return 2;
+    }
+  }
+  input = simLoad(in, &inputLength);
+  if (input == 0)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 2;
+  }
+  return firmwareMain();
+}
@@ -0,0 +1,104 @@
+/***************************************************************************
+sim.h
+
+Header file for the host build's simulator: sim.c, and the display bus
+ models in simks0108b.c and simt6963.c.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __sim_h
+#define __sim_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Simulated time since power-up, in nanoseconds. Only delays move it along;
+//  see simDelay().
+extern uint64_t simNow;
+
+// A display bus model. The simulator hands it the pins every time the
+//  firmware waits, which the drivers do after every pin change that matters,
+//  so the model gets to see every edge. If the display is driving the data
+//  bus at that moment, sample() says so and puts the value in *in, and the
+//  simulator puts it on the PIN registers for the firmware to read.
+typedef struct SIM_MODEL
+{
+  const char *name;
+  uint8_t width;    // Size of the glass, in pixels.
+  uint8_t height;
+  void    (*reset)(void);
+  // control is PORTC, data is what the AVR has on the data pins, and
+  //  dataOut says whether it's actually driving them.
+  uint8_t (*sample)(uint8_t control, uint8_t data, uint8_t dataOut,
+                    uint8_t *in);
+  // Is the pixel at (x, y) dark? This is what the glass shows, so it takes
+  //  the display on/off state, start line and so on into account.
+  uint8_t (*pixel)(uint8_t x, uint8_t y);
+} SIM_MODEL;
+
+extern const SIM_MODEL simKs0108b;
+extern const SIM_MODEL simT6963;
+
+// A model calls this when the firmware does something the real controller
+//  wouldn't put up with. Every one of them fails the run.
+void simError(const char *format, ...);
+
+// The cost model (host/cost.c). The bus models count what goes across the
+//  bus, and simDelay() counts the time spent waiting; all of it is charged to
+//  whichever lcd.c call is running at the time.
+#define SIM_STROBES      0   // Bus cycles: EN pulses, or t6963 CE cycles.
+#define SIM_SET_PAGE     1   // ks0108b set page (X address) instructions.
+#define SIM_SET_COLUMN   2   // ks0108b set column (Y address) instructions.
+#define SIM_SET_POINTER  3   // t6963 set address pointer commands.
+#define SIM_DUMMY_READS  4   // ks0108b reads that only load the output
+                             //  register, after the address moved.
+#define SIM_BUSY_POLLS   5   // Status reads.
+#define SIM_DELAY_NS     6   // Time spent in _delay_us() and friends.
+#define SIM_COUNTERS     7
+
+// Everything the firmware does that a delay doesn't account for- setting up
+//  the pins, the function calls around each bus cycle- is guessed at as
+//  this many CPU cycles per strobe. It's a rough average over the drivers'
+//  read, write and status paths; the drawing code's own arithmetic isn't
+//  counted at all, so the estimates are on the low side.
+#define SIM_CYCLES_PER_STROBE 50
+
+void simCount(uint8_t counter, uint32_t n);
+void simCostReport(FILE *out, const char *title);
+uint8_t simCostCheck(const char *modelName, const char *baselineName);
+
+// The benchmark suite (host/bench.c); runs in place of the firmware's main
+//  loop.
+void simBenchmark(uint8_t large);
+
+// The check suite (also host/bench.c). Same idea, but it looks at what ends
+//  up on the glass, and reports anything wrong through simError().
+void simCheck(uint8_t large);
+
+// Is the pixel at (x, y) dark on the display we're simulating?
+uint8_t simPixel(uint8_t x, uint8_t y);
+
+// Feed the firmware serial input, and see what it's sent back since the
+//  last call. See simSend() in sim.c.
+void simSend(const uint8_t *data, uint16_t n);
+uint8_t simSent(uint8_t *dst, uint8_t max);
+
+#endif
+
+/*
+The host build runs the firmware on a PC. The AVR's I/O registers become
+ordinary variables (host/avr/io.h), and sim.c plays the part of the rest of
+the world: it feeds bytes into the receive interrupt at the serial port's
+baud rate, collects whatever the firmware sends back, and watches the display
+bus pins through one of the two models. When the input runs out, it writes
+what's on the glass out as a PBM image.
+
+The models work at the level of the pins, not the driver functions, so they
+check the drivers as well as the drawing code above them: a wrong chip
+select, a missing dummy read or a command sent in the wrong mode shows up on
+the glass (or as an error) just as it would on a real display.
+*/
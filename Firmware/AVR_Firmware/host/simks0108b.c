@@ -0,0 +1,173 @@
+/***************************************************************************
+simks0108b.c
+
+Bus-level model of a ks0108b 128x64 display, for the host build. See sim.h.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#include <string.h>
+#include "sim.h"
+#include "../io_support.h"
+
+// How long a chip stays busy after an instruction or a data write. The
+//  datasheet's cycle time is 1us; that's what we hold the driver to.
+#define KS_BUSY_NS 1000
+
+// The display is two controllers side by side, each with 64 columns of 8
+//  pages. On this panel, the chip selects are active high, and CS2 picks the
+//  left half- that's what the driver does to the pins, anyway: commands go
+//  out with both CS lines high, to both chips, and a data write to the left
+//  half drops CS1.
+typedef struct KS_CHIP
+{
+  uint8_t  ram[8][64];
+  uint8_t  column;      // The Y address counter, in datasheet terms.
+  uint8_t  page;        // The X address.
+  uint8_t  startLine;
+  uint8_t  on;
+  uint8_t  latch;       // The output register. Reads come from here, which
+                        //  is why the first read after moving is a dummy.
+  uint8_t  stale;       // Has the address moved since the latch was loaded?
+  uint64_t busyUntil;
+} KS_CHIP;
+
+static KS_CHIP  chip[2];      // chip[0] is the left half.
+static uint8_t  lastEN;
+static uint8_t  driving;      // Are we putting something on the data bus?
+static uint8_t  driveValue;
+
+static void ksReset(void)
+{
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    chip[i].column = 0;
+    chip[i].page = 0;
+    chip[i].startLine = 0;
+    chip[i].on = 0;
+    chip[i].stale = 1;
+    chip[i].busyUntil = 0;
+  }
+  driving = 0;
+}
+
+// Which chips are selected? Bit 0 for the left one, bit 1 for the right.
+static uint8_t ksSelected(uint8_t control)
+{
+  uint8_t sel = 0;
+  if (control & (1<<CS2)) sel |= 0x01;
+  if (control & (1<<CS1)) sel |= 0x02;
+  return sel;
+}
+
+static void ksInstruction(KS_CHIP *c, uint8_t data)
+{
+  if ((data & 0xfe) == 0x3e)      c->on = data & 0x01;
+  else if ((data & 0xc0) == 0x40)
+  {
+    c->column = data & 0x3f;
+    c->stale = 1;
+  }
+  else if ((data & 0xf8) == 0xb8)
+  {
+    c->page = data & 0x07;
+    c->stale = 1;
+  }
+  else if ((data & 0xc0) == 0xc0) c->startLine = data & 0x3f;
+  else simError("ks0108b: unknown instruction 0x%02x", data);
+}
+
+static uint8_t ksSample(uint8_t control, uint8_t data, uint8_t dataOut,
+                        uint8_t *in)
+{
+  uint8_t en = (control & (1<<EN)) ? 1 : 0;
+  uint8_t rs = control & (1<<RS);
+  uint8_t rw = control & (1<<R_W);
+  uint8_t sel = ksSelected(control);
+
+  // RESET is active low, and holds everything in reset while it's low. The
+  //  display RAM is left alone.
+  if ((control & (1<<RESET)) == 0)
+  {
+    ksReset();
+    lastEN = en;
+    return 0;
+  }
+
+  if (en && !lastEN) simCount(SIM_STROBES, 1);
+  if (en && !lastEN && rw)
+  {
+    // Rising edge of a read: the selected chip puts its output register (or
+    //  its status) on the bus for as long as EN stays high.
+    driving = 1;
+    if (sel == 0x03) simError("ks0108b: read with both chips selected");
+    KS_CHIP *c = &chip[(sel & 0x01) ? 0 : 1];
+    if (sel == 0) driveValue = 0xff;  // Nobody's home; the bus floats.
+    else if (rs)
+    {
+      driveValue = c->latch;
+      if (c->stale) simCount(SIM_DUMMY_READS, 1);
+    }
+    else
+    {
+      simCount(SIM_BUSY_POLLS, 1);
+      driveValue = 0;
+      if (simNow < c->busyUntil) driveValue |= 0x80;
+      if (!c->on)                driveValue |= 0x20;
+    }
+  }
+  else if (!en && lastEN)
+  {
+    // Falling edge: this is where writes land, and where a read moves the
+    //  addressed byte into the output register and bumps the column.
+    driving = 0;
+    // Instructions usually go to both chips at once, but that's one command
+    //  as far as the cost model is concerned.
+    if (!rw && !rs && sel)
+    {
+      if ((data & 0xc0) == 0x40) simCount(SIM_SET_COLUMN, 1);
+      if ((data & 0xf8) == 0xb8) simCount(SIM_SET_PAGE, 1);
+    }
+    for (uint8_t i = 0; i < 2; i++)
+    {
+      if ((sel & (1<<i)) == 0) continue;
+      KS_CHIP *c = &chip[i];
+      if (!rw)
+      {
+        if (!dataOut) simError("ks0108b: write with the data bus floating");
+        if (simNow < c->busyUntil) simError("ks0108b: write while busy");
+        if (rs)
+        {
+          c->ram[c->page][c->column] = data;
+          c->column = (c->column + 1) & 0x3f;
+          c->stale = 1;
+        }
+        else ksInstruction(c, data);
+        c->busyUntil = simNow + KS_BUSY_NS;
+      }
+      else if (rs)
+      {
+        c->latch = c->ram[c->page][c->column];
+        c->column = (c->column + 1) & 0x3f;
+        c->stale = 0;
+      }
+    }
+  }
+  lastEN = en;
+  if (driving) *in = driveValue;
+  return driving;
+}
+
+static uint8_t ksPixel(uint8_t x, uint8_t y)
+{
+  KS_CHIP *c = &chip[(x < 64) ? 0 : 1];
+  if (!c->on) return 0;
+  uint8_t line = (y + c->startLine) & 0x3f;
+  return (c->ram[line/8][x & 0x3f] >> (line%8)) & 0x01;
+}
+
+const SIM_MODEL simKs0108b =
+  {"ks0108b", 128, 64, ksReset, ksSample, ksPixel};
@@ -0,0 +1,254 @@
+/***************************************************************************
+simt6963.c
+
+Bus-level model of a t6963 160x128 display, for the host build. See sim.h.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#include <string.h>
+#include <avr/io.h>
+#include "sim.h"
+#include "../glcdbp.h"
+#include "../io_support.h"
+#include "../lcd.h"
+
+#define T_MEMORY  0x2000  // 8k of display RAM, which is what these modules
+#define T_MASK    0x1fff  //  come with.
+
+// Status bits.
+#define STA0 0x01   // Ready for a command.
+#define STA1 0x02   // Ready for data.
+#define STA2 0x04   // Ready for the next auto read.
+#define STA3 0x08   // Ready for the next auto write.
+
+#define AUTO_OFF   0
+#define AUTO_WRITE 1
+#define AUTO_READ  2
+
+#define CYCLE_NONE  0
+#define CYCLE_WRITE 1
+#define CYCLE_READ  2
+
+static uint8_t  memory[T_MEMORY];
+static uint16_t pointer;        // The address pointer.
+static uint8_t  args[2];        // Data bytes waiting for a command to use
+static uint8_t  argCount;       //  them.
+static uint8_t  autoMode;
+static uint8_t  readLatch;      // Where a data read command leaves its byte.
+static uint16_t graphicHome;
+static uint8_t  graphicArea;    // Bytes per line.
+static uint16_t textHome;
+static uint8_t  textArea;
+static uint8_t  modeSet;        // Low nybble of the last mode set command.
+static uint8_t  displayMode;    // Low nybble of the last display mode command.
+static uint8_t  cycle;          // What we're doing this time CE is low.
+static uint8_t  driveValue;
+
+static void tReset(void)
+{
+  pointer = 0;
+  argCount = 0;
+  autoMode = AUTO_OFF;
+  graphicHome = 0;
+  graphicArea = 0;
+  textHome = 0;
+  textArea = 0;
+  modeSet = 0;
+  displayMode = 0;
+  cycle = CYCLE_NONE;
+}
+
+// Commands that take data want it written first, low byte first.
+static uint8_t tArgs(uint8_t command, uint8_t needed)
+{
+  if (argCount >= needed) return 1;
+  simError("t6963: command 0x%02x needs %d data bytes, got %d", command,
+           needed, argCount);
+  return 0;
+}
+
+static void tCommand(uint8_t command)
+{
+  uint16_t arg = args[0] | (args[1]<<8);
+  if ((autoMode != AUTO_OFF) && (command != 0xb2))
+  {
+    simError("t6963: command 0x%02x in auto mode", command);
+    return;
+  }
+  if ((command & 0xf0) == 0x80)      modeSet = command & 0x0f;
+  else if ((command & 0xf0) == 0x90) displayMode = command & 0x0f;
+  else if ((command & 0xf8) == 0xa0) ;  // Cursor pattern; we've no cursor.
+  else if ((command & 0xf0) == 0xf0)
+  {
+    // Bit set/reset, at the pointer, which stays put.
+    uint8_t bit = 1<<(command & 0x07);
+    if (command & 0x08) memory[pointer & T_MASK] |= bit;
+    else                memory[pointer & T_MASK] &= ~bit;
+  }
+  else switch (command)
+  {
+    case 0x21:  // Cursor pointer and offset register; nothing to see here.
+    case 0x22:
+    tArgs(command, 2);
+    break;
+    case 0x24:
+    simCount(SIM_SET_POINTER, 1);
+    if (tArgs(command, 2)) pointer = arg;
+    break;
+    case 0x40:
+    if (tArgs(command, 2)) textHome = arg;
+    break;
+    case 0x41:
+    if (tArgs(command, 2)) textArea = args[0];
+    break;
+    case 0x42:
+    if (tArgs(command, 2)) graphicHome = arg;
+    break;
+    case 0x43:
+    if (tArgs(command, 2)) graphicArea = args[0];
+    break;
+    case 0xb0:
+    autoMode = AUTO_WRITE;
+    break;
+    case 0xb1:
+    autoMode = AUTO_READ;
+    break;
+    case 0xb2:
+    autoMode = AUTO_OFF;
+    break;
+    case 0xc0:  // Data write, then move the pointer up, down or not at all.
+    case 0xc2:
+    case 0xc4:
+    if (tArgs(command, 1)) memory[pointer & T_MASK] = args[0];
+    if (command == 0xc0) pointer++;
+    if (command == 0xc2) pointer--;
+    break;
+    case 0xc1:  // Data read, likewise. The byte turns up on the next read.
+    case 0xc3:
+    case 0xc5:
+    readLatch = memory[pointer & T_MASK];
+    if (command == 0xc1) pointer++;
+    if (command == 0xc3) pointer--;
+    break;
+    default:
+    simError("t6963: unknown command 0x%02x", command);
+    break;
+  }
+  argCount = 0;
+}
+
+static void tData(uint8_t data)
+{
+  if (autoMode == AUTO_WRITE) memory[(pointer++) & T_MASK] = data;
+  else if (autoMode == AUTO_READ) simError("t6963: data write in auto read");
+  else
+  {
+    // Only the last two count.
+    if (argCount == 2)
+    {
+      args[0] = args[1];
+      argCount = 1;
+    }
+    args[argCount++] = data;
+  }
+}
+
+static uint8_t tStatus(void)
+{
+  if (autoMode == AUTO_WRITE) return STA3;
+  if (autoMode == AUTO_READ)  return STA2;
+  return STA0 | STA1;
+}
+
+static uint8_t tSample(uint8_t control, uint8_t data, uint8_t dataOut,
+                       uint8_t *in)
+{
+  // RST is active low. Display memory survives it.
+  if ((control & (1<<RST)) == 0)
+  {
+    tReset();
+    return 0;
+  }
+  // Nothing happens unless CE is low; once it is, the first sample that sees
+  //  WR or RD low is the transaction, and it lasts until CE goes back up.
+  if (control & (1<<CE))
+  {
+    cycle = CYCLE_NONE;
+    return 0;
+  }
+  if (cycle == CYCLE_READ)
+  {
+    *in = driveValue;
+    return 1;
+  }
+  if (cycle == CYCLE_WRITE) return 0;
+
+  uint8_t wr = ((control & (1<<WR)) == 0);
+  uint8_t rd = ((control & (1<<RD)) == 0);
+  if (wr && rd) simError("t6963: WR and RD both low");
+  if (wr || rd) simCount(SIM_STROBES, 1);
+  if (wr)
+  {
+    cycle = CYCLE_WRITE;
+    if (!dataOut) simError("t6963: write with the data bus floating");
+    if (control & (1<<CD)) tCommand(data);
+    else                   tData(data);
+    return 0;
+  }
+  if (rd)
+  {
+    cycle = CYCLE_READ;
+    if (control & (1<<CD))
+    {
+      simCount(SIM_BUSY_POLLS, 1);
+      driveValue = tStatus();
+    }
+    else if (autoMode == AUTO_READ) driveValue = memory[(pointer++) & T_MASK];
+    else if (autoMode == AUTO_OFF)  driveValue = readLatch;
+    else
+    {
+      simError("t6963: data read in auto write");
+      driveValue = 0xff;
+    }
+    *in = driveValue;
+    return 1;
+  }
+  return 0;
+}
+
+// The text layer uses the controller's own character ROM, which we don't
+//  have; our font is close enough to read.
+static uint8_t tTextPixel(uint8_t x, uint8_t y)
+{
+  uint8_t code = memory[(textHome + (y/8) * textArea + (x/8)) & T_MASK];
+  uint8_t col = x%8;
+  if ((code > ('~' - ' ')) || (col > 4)) return 0;
+  return (pgm_read_byte(&characterArray[code*5 + col]) >> (y%8)) & 0x01;
+}
+
+static uint8_t tPixel(uint8_t x, uint8_t y)
+{
+  uint8_t graphic = 0;
+  uint8_t text = 0;
+  if (displayMode & 0x08)
+  {
+    uint16_t addr = graphicHome + (y * graphicArea) + (x>>3);
+    graphic = (memory[addr & T_MASK] >> (7 - (x%8))) & 0x01;
+  }
+  if ((displayMode & 0x04) == 0) return graphic;
+  text = tTextPixel(x, y);
+  switch (modeSet & 0x07)
+  {
+    case 0x00: return graphic | text;
+    case 0x01: return graphic ^ text;
+    case 0x03: return graphic & text;
+    default:   return text;
+  }
+}
+
+const SIM_MODEL simT6963 =
+  {"t6963", 160, 128, tReset, tSample, tPixel};
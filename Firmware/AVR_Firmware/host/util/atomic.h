@@ -0,0 +1,32 @@
+/***************************************************************************
+util/atomic.h (host build)
+
+Stand-in for avr-libc's <util/atomic.h>. The block runs once with the
+ simulator's interrupts held off, and puts them back the way they were.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __host_util_atomic_h
+#define __host_util_atomic_h
+
+#include <avr/interrupt.h>
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+static inline uint8_t simAtomicEnter(void)
+{
+  uint8_t saved = simInterrupts;
+  simInterrupts = 0;
+  return saved | 0x80;  // Never zero, so the loop below runs once.
+}
+
+#define ATOMIC_BLOCK(type)                                        \
+  for (uint8_t simSaved = simAtomicEnter(); simSaved;             \
+       simInterrupts = simSaved & 0x01, simSaved = 0)
+
+#endif
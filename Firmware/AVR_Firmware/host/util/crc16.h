@@ -0,0 +1,40 @@
+/***************************************************************************
+util/crc16.h (host build)
+
+Stand-in for avr-libc's <util/crc16.h>. These are the C equivalents given
+ in the avr-libc documentation for the inline assembly versions.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __host_util_crc16_h
+#define __host_util_crc16_h
+
+#include <stdint.h>
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+  data ^= crc;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    if (data & 0x80) data = (data << 1) ^ 0x07;
+    else             data <<= 1;
+  }
+  return data;
+}
+
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+  crc ^= a;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    if (crc & 1) crc = (crc >> 1) ^ 0xA001;
+    else         crc = (crc >> 1);
+  }
+  return crc;
+}
+
+#endif
@@ -0,0 +1,25 @@
+/***************************************************************************
+util/delay.h (host build)
+
+Stand-in for avr-libc's <util/delay.h>. Delays don't take any real time;
+ they move the simulator's clock forward. They're also where the simulator
+ samples the display bus, since the drivers wait a little after every pin
+ change that matters.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#ifndef __host_util_delay_h
+#define __host_util_delay_h
+
+#include <stdint.h>
+
+void simDelay(uint32_t ns);
+
+#define _delay_us(us) simDelay((uint32_t)((us) * 1000UL))
+#define _delay_ms(ms) simDelay((uint32_t)((ms) * 1000000UL))
+
+#endif
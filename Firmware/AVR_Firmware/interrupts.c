@@ -2,7 +2,9 @@
 interrupts.c
 
 Interrupt definition file for the serial graphical LCD backpack project. The
- only actual interrupt handler is the serial receive handler. It lives here.
+ main interrupt handler is the serial receive handler. It lives here, along
+ with the serial transmit handler and the Timer2 overflow handler the
+ benchmark uses.
 
 02 May 2013 - Mike Hord, SparkFun Electronics
 
@@ -12,22 +14,61 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 
 ***************************************************************************/
 
-#include <AVR/interrupt.h>
+#include <avr/interrupt.h>
 #include "glcdbp.h"
+#include "serial.h"
 
 extern volatile uint8_t 	rxRingBuffer[BUF_DEPTH];
-extern volatile uint16_t 	rxRingHead;
-extern volatile uint16_t	rxRingTail;
-extern volatile uint8_t	 bufferSize;
+extern volatile uint8_t 	rxRingHead;
+extern volatile uint8_t	rxRingTail;
+extern volatile uint8_t  rxThrottled;
+extern volatile uint16_t rxOverflows;
+extern volatile uint16_t rxOverruns;
+extern volatile uint8_t  rxHighWater;
+extern volatile uint16_t timer2Overflows;
 
 // Handler for USART receive interrupts. This is basically just a stack push
-//  for the FIFO we use to store incoming commands. Note that there is no
-//  overflow; that might be a nice touch but so far, I haven't even come close
-//  to hitting the buffer depth. In fact, I've never exceeded a depth of more
-//  than two or three bytes.
+//  for the FIFO we use to store incoming commands. It turns out that a big
+//  enough circle or erase on the small display takes long enough for a host
+//  streaming at full speed to fill the buffer, so if the buffer is full, we
+//  drop the byte and count it, and as the buffer gets close to full, we ask
+//  the host to back off (if flow control is enabled).
+// This is the only place rxRingHead gets written, and we store the byte
+//  before we move the head past it, so the main loop never needs to turn
+//  interrupts off to read the buffer safely.
 ISR(USART_RX_vect)
 {
-	if (rxRingHead == BUF_DEPTH) rxRingHead = 0;
-	bufferSize++;
-	rxRingBuffer[rxRingHead++] = UDR0;
+	// The data overrun flag has to be read before UDR0; it means a byte came
+	//  and went before we got here.
+	if (UCSR0A & (1<<DOR0)) rxOverruns++;
+	uint8_t rxByte = UDR0;
+	uint8_t head = rxRingHead;
+	uint8_t count = head - rxRingTail;
+	// With the 8-bit indices, a count of BUF_DEPTH would look like empty, so
+	//  one slot always stays empty.
+	if (count == (uint8_t)BUF_MASK)
+	{
+		rxOverflows++;
+		return;
+	}
+	rxRingBuffer[head & BUF_MASK] = rxByte;
+	rxRingHead = head + 1;
+	count++;
+	if (count > rxHighWater) rxHighWater = count;
+	if ((count >= RX_HIGH_WATER) && (rxThrottled == 0)) serialThrottle();
+}
+
+// Handler for USART data register empty interrupts: the USART can take
+//  another byte. serialTxNext() (in serial.c) gives it one, and turns this
+//  interrupt off once there's nothing left to send.
+ISR(USART_UDRE_vect)
+{
+	serialTxNext();
+}
+
+// Timer2 counts to 255 and rolls over; this counts the rollovers, so the
+//  benchmark (see benchmark.c) can time things longer than 128us.
+ISR(TIMER2_OVF_vect)
+{
+	timer2Overflows++;
 }
@@ -15,18 +15,16 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 ***************************************************************************/
 
 #include <avr/io.h>
+#include <util/atomic.h>
 #include "glcdbp.h"
 #include "io_support.h"
 
-// This is setup in glcdbp.c and is used to track the "type" of the display
-//  throughout the code.
-extern enum DISPLAY_TYPE display;
-
 void ioInit(void)
 {
   // Set up the data direction registers for the data bus pins.
-  //  The data bus is on PB0:1 and PD2:7, so make those pins outputs.
-  DDRB = 0b00001111;
+  //  The data bus is on PB0:1 and PD2:7, so make those pins outputs. PB4 is
+  //  the RTS output; it starts out low, which tells the host to send away.
+  DDRB = 0b00011111;
   DDRD = 0b11111100;
 
   PORTB &= ~(1<<nBL_EN);  // Turn backlight on
@@ -52,13 +50,17 @@ void setData(uint8_t data)
   DDRB |= 0x03;
   DDRD |= 0xFC;
   
-  PORTB &= 0xFC;    // Clear PB7:2 in preparation for data.
-  PORTD &= 0x03;    // Clear PD1:0.
-  
-  PORTB |= (data & 0x03); // Mask off PB1:0 so we don't change them
-                          //  and then write the other 6 bits.
-  PORTD |= (data & 0xFC); // Mask off PD7:2 so we don't change them
-                          //  and then write the other two bits.
+  // The serial receive interrupt can flip the RTS pin, which is also on
+  //  PORTB; if it happened in the middle of our read-modify-write here, we'd
+  //  put RTS right back the way it was. So, no interrupts while we do this.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    PORTB = (PORTB & 0xFC) | (data & 0x03); // Replace PB1:0 and leave the
+                                            //  rest of the port alone.
+  }
+  PORTD &= 0x03;    // Clear PD7:2.
+  PORTD |= (data & 0xFC); // Mask off PD1:0 so we don't change them
+                          //  and then write the other six bits.
                           //  The data is now in place.
 }
 
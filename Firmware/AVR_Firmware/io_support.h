@@ -18,6 +18,9 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 // Pinout definitions.
 
 #define nBL_EN 		2	//PB2 is backlight enable, and is active low
+#define RTS     4	// PB4 is RTS for hardware flow control. Low means "go
+              //  ahead and send", high means "stop". It's on the ISP
+              //  header, which is the only place we have a spare pin.
 
 // Pins for the ks0108b (128x64) display
 #define EN      0	// PC0
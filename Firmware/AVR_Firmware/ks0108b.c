@@ -20,6 +20,7 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 #include "lcd.h"
 #include "ks0108b.h"
 #include "serial.h"
+#include "nvm.h"
 
 #define E_DELAY 5 // This delay is the minimum time EN will be
               //  low or high when enable is strobed. By the
@@ -31,14 +32,129 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
               //  data reads. Again, it shouldn't *need* to
               //  be this long, but the datasheet speaks
               //  great falsehoods. Value in microseconds.
-              
+// Those two are the worst case, and what we fall back on when all else
+//  fails. Normally, we find out at startup how short the strobes can be on
+//  this particular panel (see ks0108bCalibrate()), and then rather than wait
+//  out a fixed cycle time after each write, we ask the chip whether it's
+//  done yet. A timing profile in EEPROM (see ui.h, CTRL-j) overrides all of
+//  that with fixed delays, for panels that don't get along with it.
+static uint8_t strobeDelay = E_DELAY;  // These are what we actually use;
+static uint8_t readDelay = R_DELAY;    //  microseconds, like the above.
+static uint8_t busyPolling = 0;        // Check the busy flag before each
+                                       //  operation?
+
+#define KS_LEFT   0x01  // Chips, for ks0108bWaitReady().
+#define KS_RIGHT  0x02
+#define KS_BOTH   (KS_LEFT | KS_RIGHT)
+
+#define KS_BUSY   0x80  // Status register bits.
+#define KS_RESET  0x10
+
+#define KS_POLL_LIMIT 100 // If a chip's been busy this many polls in a row,
+                          //  it isn't really; it's not answering.
+
 uint8_t column = 0; // We want to be able to track the current
               //  x position sometimes; it allows us to pick up where other
               //  functions leave off.
-              
+static uint8_t page = 0;  // And the page that goes with it.
+
+// What we know about the address counters inside the two chips (index 0 is
+//  the left half). Setting the page or column doesn't go to the glass right
+//  away; it waits until there's a read or write to do, and then only goes to
+//  the chip that's involved, and only if that chip isn't already there. The
+//  column counter moves along by one with every data read or write, and
+//  wraps at 64, so text and runs across the page mostly don't need any
+//  address instructions at all. 0xFF means we don't know (after a reset).
+static uint8_t chipPage[2] = {0xFF, 0xFF};
+static uint8_t chipColumn[2] = {0xFF, 0xFF};
+// A read hands back whatever was in the chip's output register, and then
+//  reloads it from the current address. That's why reads need a dummy read
+//  first- but if the last thing we did to a chip was read from the column
+//  just before this one, the register is already holding what we want.
+static uint8_t chipLatch[2] = {0, 0};  // 1 if the output register is good.
+
+// Hardware scrolling: the display starts drawing from this page of RAM
+//  rather than page 0 (see ks0108bScroll()), so screen row y lives on RAM
+//  page (y/8 + scrollPage) % 8. ks0108bPage() does that sum for everybody
+//  who takes screen coordinates; below that, everything's RAM pages.
+static uint8_t scrollPage = 0;
+
 extern volatile uint8_t reverse; // Dark-on-light or light-on-dark?
                                  //  Declared in glcdbp.c
 
+#if KS0108B_SHADOW_PAGES > 0
+// The shadow framebuffer. Reading from the glass is *slow* (four EN strobes
+//  with a 10us wait around each), so when we have the RAM to spare we keep a
+//  copy of some or all of the pages here and do our read-modify-writes
+//  against that instead. Each slot holds one 128-column page; a page always
+//  lands in slot (page % KS0108B_SHADOW_PAGES), so with fewer than 8 slots
+//  the cache slides along behind wherever we're drawing. A slot only gets
+//  the columns we've actually touched, one at a time, so taking a page over
+//  costs nothing up front, and a miss never costs more than drawing straight
+//  on the glass would have.
+static uint8_t shadow[KS0108B_SHADOW_PAGES][128];
+static uint8_t shadowTag[KS0108B_SHADOW_PAGES] = // Page held in each slot;
+                 {[0 ... KS0108B_SHADOW_PAGES-1] = 0xFF}; //  0xFF is empty.
+static uint8_t shadowValid[KS0108B_SHADOW_PAGES][16]; // One bit per column:
+                                                      //  is it loaded?
+static uint8_t shadowDirty[KS0108B_SHADOW_PAGES][16]; // One bit per column:
+                                                      //  does it need writing?
+static uint8_t shadowClean = 0;  // Bit n set means page n on the glass is
+                                 //  still solid shadowFill since the last
+                                 //  clear, so loading it needs no reads.
+static uint8_t shadowFill = 0;   // What the last clear filled the glass with.
+static uint8_t shadowPending = 0; // Has anything been stored since the last
+                                  //  flush?
+#endif
+
+// _delay_us() only takes constants, so the variable delays are made of a
+//  string of 1us ones.
+static void ksDelay(uint8_t us)
+{
+  while (us--) _delay_us(1);
+}
+
+// Read one chip's status register, and keep at it until the busy bit (and
+//  the reset bit, which means much the same thing) goes away. csOff is the
+//  CS line to drop to pick out that chip, same as for a data write: CS1 for
+//  the left half, CS2 for the right. If the busy bit never clears, the chip
+//  isn't answering status reads properly; stop asking, and go back to the
+//  slow, safe delays.
+static void ks0108bPollChip(uint8_t csOff)
+{
+  uint8_t tries = 0;
+  hiZDataPins();
+  PORTC &= ~((1<<RS) | (1<<csOff));  // Status lives in the instruction
+  PORTC |= (1<<R_W);                 //  register, and we're reading.
+  while (1)
+  {
+    _delay_us(1);    // Setup time; the datasheet wants a lot less.
+    PORTC |= (1<<EN);
+    ksDelay(strobeDelay);
+    uint8_t status = readData();
+    PORTC &= ~(1<<EN);
+    _delay_us(1);    // Hold time, before anything else moves.
+    if ((status & (KS_BUSY | KS_RESET)) == 0) break;
+    if (++tries == KS_POLL_LIMIT)
+    {
+      busyPolling = 0;
+      strobeDelay = E_DELAY;
+      readDelay = R_DELAY;
+      break;
+    }
+  }
+  setPinsDefault();
+}
+
+// Wait for the chip(s) we're about to talk to to be ready. Without busy
+//  polling, the delays in strobeEN() have already taken care of it.
+static void ks0108bWaitReady(uint8_t chips)
+{
+  if (busyPolling == 0) return;
+  if (chips & KS_LEFT)  ks0108bPollChip(CS1);
+  if (chips & KS_RIGHT) ks0108bPollChip(CS2);
+}
+
 // ks0108bReset()- pretty self explanatory, but I'm not really sure what
 //  the point of twiddling the reset line is, as it doesn't seem to really
 //  *reset* anything on the display. Makes us feel good, though.
@@ -48,12 +164,22 @@ void ks0108bReset(void)
   _delay_ms(50);
   PORTC |= (1<<RESET);
   _delay_ms(50);
+  // The address counters are back to zero now, but we'll just forget what
+  //  we knew and let the next read or write set them.
+  for (uint8_t chip = 0; chip < 2; chip++)
+  {
+    chipPage[chip] = 0xFF;
+    chipColumn[chip] = 0xFF;
+    chipLatch[chip] = 0;
+  }
+  scrollPage = 0;  // Reset puts the start line back to 0, too.
 }
 
 // Enable the display. Should only need to do this at startup time.
 void ks0108bDisplayOn(void)
 {
   // Data lines should be 0x3F for display enable.
+  ks0108bWaitReady(KS_BOTH);
   PORTC &= ~( (1<<R_W)|      // Clear R_W (Write mode)
               (1<<RS));      // Clear RS (Instruction mode)
   setData(0x3F);
@@ -62,60 +188,76 @@ void ks0108bDisplayOn(void)
   setPinsDefault();
 }
 
-// It's possible, if kinda weird, to tell the ks0108b that the start line is
-//  not the top line of the display. We're not going to truck with that crap-
-//  we'll just start at the top and call it good.
-void ks0108bSetStartLine(void)
-{
-  PORTC &= ~( (1<<CS1)| // Let's hit both chips.
-              (1<<CS2)|
-              (1<<R_W)|  // Clear R_W (Write mode)
-              (1<<RS));  // Clear RS (Register select for
-                         //  enable register)
-  // Data lines should be 0xC0 for set start line to 0.
-  setData(0xC0);
-  strobeEN();
-  hiZDataPins();     // Avoid bus contention with the ks0108b driver.
-  setPinsDefault();
-}
-
 // As mentioned elsewhere, this display is divided into 8 meta-rows (or pages,
-//  to use the datasheet nomenclature), and within each of those pages are 32
-//  columns. This function points us to one of those columns. We'll figure out
-//  which half of the screen we're on in the next stage or our operation- that
-//  will determine which chip select line we need to assert, since we don't
-//  need to assert a CS line here (it wouldn't help anyway).
+//  to use the datasheet nomenclature), and within each of those pages are 128
+//  columns, 64 on each chip. This function points us to one of those
+//  columns. Nothing goes to the display yet; ks0108bAddress() takes care of
+//  that when there's something to read or write.
 void ks0108bSetColumn(uint8_t address)
 {  
-  PORTC &= ~( (1<<R_W)|
-              (1<<RS));
-  // For Y writes, bits 7:6 of the data bus should be set to 01. We should
-  //  just make sure that's done before we do anything else...
-  column = address;
-  address = (address | 0x40) & 0x7F;
-  setData(address);
-  strobeEN();
-  hiZDataPins();     // Avoid bus contention with the ks0108b driver.
-  setPinsDefault();
+  column = address & 0x7F;
 }
 
-// Select the page (meta-row) that we're currently looking at. This puts BOTH
-//  halves of the screen on the same page, so writes that proceed across from
-//  L to R can continue across the page boundary without interruption.
+// Select the page (meta-row) that we're currently looking at. Like the
+//  column, this is only a note to ourselves until the next read or write.
 void ks0108bSetPage(uint8_t address)
 {  
-  // Now, on to the actual port manipulations needed to make this happen.
+  page = address & 0x07;
+}
+
+// Pick out the chip(s) for the next strobe: drop CS1 to talk to the left
+//  half, CS2 for the right, and neither to talk to both at once.
+static void ks0108bSelect(uint8_t chips)
+{
+  if (chips == KS_LEFT)  PORTC &= ~(1<<CS1);
+  if (chips == KS_RIGHT) PORTC &= ~(1<<CS2);
+}
+
+// Send an address instruction to one chip or both (KS_LEFT and so on).
+static void ks0108bInstruction(uint8_t chips, uint8_t instruction)
+{
+  ks0108bWaitReady(chips);
   PORTC &= ~( (1<<R_W)|      // Clear R_W (Write mode)
-              (1<<RS));      // Clear RS (Register select for
-                             //  address registers)
-  // For X writes, bits 7:3 of the data bus should be set to 10111. We should
-  //  just make sure that's done before we do anything else...
-  address = (address | 0xB8) & 0xBF;
-  setData(address);
+              (1<<RS));      // Clear RS (Instruction mode)
+  ks0108bSelect(chips);
+  setData(instruction);
   strobeEN();
   hiZDataPins();     // Avoid bus contention with the ks0108b driver.
   setPinsDefault();
+  if (chips & KS_LEFT)  chipLatch[0] = 0;
+  if (chips & KS_RIGHT) chipLatch[1] = 0;
 }
+
+// Tell both chips which line of RAM goes at the top of the screen. The
+//  display wraps around, so whatever's above that line shows up at the
+//  bottom; that's what makes scrolling cheap.
+void ks0108bSetStartLine(uint8_t line)
+{
+  // For start line, bits 7:6 of the data bus should be set to 11.
+  ks0108bInstruction(KS_BOTH, 0xC0 | (line & 0x3F));
+}
+
+// Get the chip that 'column' is on pointed at 'page' and 'column', sending
+//  only the instructions it actually needs. Returns the chip.
+static uint8_t ks0108bAddress(void)
+{
+  uint8_t chip = (column < 64) ? 0 : 1;
+  uint8_t y = column & 0x3F;
+  if (chipPage[chip] != page)
+  {
+    // For X writes, bits 7:3 of the data bus should be set to 10111.
+    ks0108bInstruction(1<<chip, 0xB8 | page);
+    chipPage[chip] = page;
+  }
+  if (chipColumn[chip] != y)
+  {
+    // For Y writes, bits 7:6 of the data bus should be set to 01.
+    ks0108bInstruction(1<<chip, 0x40 | y);
+    chipColumn[chip] = y;
+  }
+  return chip;
+}
+
 // ks0108bWriteData- write a data byte to the controller. This is only for
 //  writing data that is expected to appear on screen, but then, that's
 //  really *all* this LCD lets you write data for!
@@ -124,10 +266,10 @@ void ks0108bWriteData(uint8_t data)
   // By tracking what column we're writing to, we can avoid having to
   //  do any weird "which side am I on" logic, keeping the interface more
   //  intuitive.
-  if (column < 64)   PORTC &= ~( (1<<CS1) |
-                                 (1<<R_W));
-  else               PORTC &= ~( (1<<CS2) |
-                                 (1<<R_W));
+  uint8_t chip = ks0108bAddress();
+  ks0108bWaitReady(1<<chip);
+  PORTC &= ~(1<<R_W);
+  ks0108bSelect(1<<chip);
   
   // setData() is a function which abstracts the fact that the data lines
   //  to the LCD are not on the same port.
@@ -139,14 +281,44 @@ void ks0108bWriteData(uint8_t data)
   // The act of writing a data byte to the display causes the display's
   //  internal pointer to increment. We need to update our pointer to
   //  account for that, but if the update pushes our pointer past the
-  //  edge, we want to wrap back around. The display doesn't handle
-  //  wrapping automatically, so we need to wrap it manually with the
-  //  set column function.
-  if (++column > 127) 
+  //  edge, we want to wrap back around. The chip's own counter wraps at
+  //  64, so when we cross into the other half (or back to column 0), the
+  //  other chip's counter probably won't match, and ks0108bAddress() will
+  //  set it next time.
+  chipColumn[chip] = (chipColumn[chip] + 1) & 0x3F;
+  chipLatch[chip] = 0;
+  if (++column > 127) column = 0;
+}
+
+// Write the same byte n times to both halves at once, starting at column x
+//  of the left half (and so x+64 of the right), on the current page. With
+//  both chips selected, every strobe lands twice, so a clear or a wide fill
+//  takes half as many. The two column counters march along together; if
+//  either chip isn't where it needs to be, both get told, in one instruction.
+static void ks0108bWriteBoth(uint8_t x, uint8_t data, uint8_t n)
+{
+  if ((chipPage[0] != page) || (chipPage[1] != page))
+  {
+    ks0108bInstruction(KS_BOTH, 0xB8 | page);
+    chipPage[0] = chipPage[1] = page;
+  }
+  if ((chipColumn[0] != x) || (chipColumn[1] != x))
   {
-    column = 0;
-    ks0108bSetColumn(0);
+    ks0108bInstruction(KS_BOTH, 0x40 | x);
+    chipColumn[0] = chipColumn[1] = x;
   }
+  while (n--)
+  {
+    ks0108bWaitReady(KS_BOTH);
+    PORTC &= ~(1<<R_W);
+    setData(data);
+    strobeEN();
+    hiZDataPins();
+    setPinsDefault();
+    chipColumn[0] = chipColumn[1] = (chipColumn[0] + 1) & 0x3F;
+  }
+  chipLatch[0] = chipLatch[1] = 0;
+  column = chipColumn[0];
 }
 
 // Read a column of pixel data. The operation is basically thus:
@@ -156,35 +328,107 @@ void ks0108bWriteData(uint8_t data)
 //   4. Pull EN high.
 //   5. Data is available to be read.
 //   6. Reset signal lines to rest state.
+//  Steps 2 and 3 are the dummy read, and we can skip them when the chip's
+//  output register already holds column x- that is, when the last thing we
+//  did to the chip was read column x-1.
 uint8_t ks0108bReadData(uint8_t x)
 {  
   uint8_t data;
-  
-  if (x<64)  // Are we on the left half of the display?
-  {  
-    PORTC &= ~(1<<CS1);
-  }
-  else       // Or the right half of the display?
-  {  
-    PORTC &= ~(1<<CS2);
-  }
+  uint8_t chip = (x < 64) ? 0 : 1;
+  uint8_t dummy = 1;
+
+  ks0108bSetColumn(x);
+  if (chipLatch[chip] && (chipPage[chip] == page) &&
+      (chipColumn[chip] == ((x + 1) & 0x3F))) dummy = 0;
+  else ks0108bAddress();
+  ks0108bWaitReady(1<<chip);
+  ks0108bSelect(1<<chip);
   // The number of twiddles of EN is...bizarre. This was established via
   //  experimentation, rather than through any actual data sheet content.
-  _delay_us(R_DELAY);
-  PORTC |= (1<<EN);
-  _delay_us(R_DELAY);
-  PORTC &= ~(1<<EN);
-  _delay_us(R_DELAY);
+  ksDelay(readDelay);
+  if (dummy)
+  {
+    PORTC |= (1<<EN);
+    ksDelay(readDelay);
+    PORTC &= ~(1<<EN);
+    ksDelay(readDelay);
+  }
   PORTC |= (1<<EN);  
-  _delay_us(R_DELAY);
+  ksDelay(readDelay);
   data = readData();  
   PORTC &= ~(1<<EN);
-  _delay_us(R_DELAY);
+  ksDelay(readDelay);
   setPinsDefault();
+  // Either way, the chip's counter ends up two past x, with column x+1
+  //  waiting in the output register.
+  chipColumn[chip] = (x + 2) & 0x3F;
+  chipLatch[chip] = 1;
   return data;
 }
 
-// Clear is janky- set x and y to zero and write across the screen.
+// Everything it takes to get the display from power-up to a blank screen.
+//  The timing gets sorted out while the display's still off, so nobody sees
+//  the test patterns.
+void ks0108bInit(void)
+{
+  uint8_t strobe = getKsStrobeDelay();
+  uint8_t read = getKsReadDelay();
+  ks0108bReset();
+  if (strobe && read)
+  {
+    strobeDelay = strobe;
+    readDelay = read;
+    busyPolling = 0;
+  }
+  else ks0108bCalibrate();
+  ks0108bDisplayOn();
+  ks0108bClear();
+}
+
+// Write a few patterns to both chips and read them back, using the current
+//  timing. Returns 1 if they all came back right.
+static uint8_t ks0108bTimingTest(void)
+{
+  static const uint8_t patterns[4] = {0x55, 0xAA, 0x0F, 0xF0};
+  for (uint8_t half = 0; half < 128; half += 64)
+  {
+    ks0108bSetPage(0);
+    ks0108bSetColumn(half);
+    for (uint8_t i = 0; i < 4; i++) ks0108bWriteData(patterns[i] ^ half);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      ks0108bSetColumn(half + i);
+      if (ks0108bReadData(half + i) != (patterns[i] ^ half)) return 0;
+    }
+  }
+  return 1;
+}
+
+// Find the shortest strobe that reliably gets data in and out of this
+//  panel, with busy polling on, and then back off a notch for margin. Reads
+//  get twice as long as writes, the same as the worst case numbers. If
+//  nothing works- or the busy flag never clears- it's the old fixed delays.
+void ks0108bCalibrate(void)
+{
+  for (uint8_t delay = 1; delay < E_DELAY; delay++)
+  {
+    strobeDelay = delay;
+    readDelay = 2*delay;
+    busyPolling = 1;
+    if (ks0108bTimingTest() && busyPolling)
+    {
+      strobeDelay = delay + 1;
+      readDelay = 2*(delay + 1);
+      return;
+    }
+  }
+  strobeDelay = E_DELAY;
+  readDelay = R_DELAY;
+  busyPolling = 0;
+}
+
+// Clear is janky- set x and y to zero and write across the screen. Both
+//  halves get the same thing, so they get it at the same time.
 void ks0108bClear(void)
 {
   uint8_t clearVal = 0;
@@ -192,14 +436,50 @@ void ks0108bClear(void)
   for (uint8_t y = 0; y<8; y++)
   {
     ks0108bSetPage(y);
-    ks0108bSetColumn(0);
-    for (uint8_t x = 0; x<128; x++)
-    {
-      ks0108bWriteData(clearVal);
-    }
+    ks0108bWriteBoth(0, clearVal, 64);
   }
   ks0108bSetPage(0);
   ks0108bSetColumn(0);
+#if KS0108B_SHADOW_PAGES > 0
+  // The glass is now a known quantity, so the shadow can be, too. Anything
+  //  still dirty in the shadow was just overwritten anyway.
+  shadowFill = clearVal;
+  shadowClean = 0xFF;
+  for (uint8_t slot = 0; slot < KS0108B_SHADOW_PAGES; slot++)
+  {
+    shadowTag[slot] = slot;
+    for (uint8_t i = 0; i < 16; i++)
+    {
+      shadowValid[slot][i] = 0;
+      shadowDirty[slot][i] = 0;
+    }
+  }
+#endif
+}
+
+// The RAM page holding screen row y, allowing for the scroll. Rows off the
+//  bottom of the screen are left off the bottom, so the edge checks further
+//  down still catch them.
+static uint8_t ks0108bPage(uint8_t y)
+{
+  uint8_t page = y/8;
+  if (page > 7) return page;
+  return (page + scrollPage) & 0x07;
+}
+
+// Scroll everything on the screen up one page (8 pixels, a line of text).
+//  The top page gets blanked, and then moving the start line puts it at the
+//  bottom; nothing else on the screen needs to be touched. From here on,
+//  ks0108bPage() sends screen coordinates to their new home.
+void ks0108bScroll(void)
+{
+  ks0108bFillRun(0, 0, 128, OFF);
+  // With a shadow, that blank is only in the shadow so far, but the start
+  //  line goes to the glass right now- so get the blank out there first, or
+  //  the old top line shows up at the bottom until the next flush.
+  ks0108bFlush();
+  scrollPage = (scrollPage + 1) & 0x07;
+  ks0108bSetStartLine(scrollPage * 8);
 }
 
 // ks0108bReadBlock()- reads an 8x8 block of arbitrary pixels from the display.
@@ -214,17 +494,15 @@ void ks0108bReadBlock(uint8_t x, uint8_t y, uint8_t *buffer)
   secondRowPixels = 8 - (y%8);
   // Okay, now we know how many pixels are in each row. Now let's pull the
   //  data from those two rows.
-  ks0108bSetPage(y/8);
   for (uint8_t i = 0; i<8; i++)
   {
     // Fetch the data and left-shift it so the topmost pixel of the group
     //  we're interested in is the MSB.
-    buffer[i] = ks0108bReadData(x+i)<<(8-firstRowPixels);
+    buffer[i] = ks0108bFetch(x+i, ks0108bPage(y))<<(8-firstRowPixels);
   }
-  ks0108bSetPage((y/8) + 1);
   for (uint8_t i = 0; i<8; i++)
   {
-    buffer[i] |= ks0108bReadData(x+i)>>(8-secondRowPixels);
+    buffer[i] |= ks0108bFetch(x+i, ks0108bPage(y + 8))>>(8-secondRowPixels);
   }
 }
 
@@ -234,10 +512,10 @@ void ks0108bReadBlock(uint8_t x, uint8_t y, uint8_t *buffer)
 //  byte.
 void ks0108bDrawPixel(uint8_t x, uint8_t y, PIX_VAL pixel)
 {
-  ks0108bSetColumn(x);  // x is simple; it's just the x coordinate.
-  ks0108bSetPage(y/8);  // y is less simple; we need to find the page that the
-                        //  pixel in question resides on.
-  uint8_t currentPixelData = ks0108bReadData(x);  // fetch the existing state
+  // x is simple; it's just the x coordinate. y is less simple; we need to
+  //  find the page that the pixel in question resides on.
+  uint8_t page = ks0108bPage(y);
+  uint8_t currentPixelData = ks0108bFetch(x, page);  // fetch the existing state
   uint8_t pixelToWrite = (y%8);  // determine which pixel to write
   // This section handles the specifics- do we want to turn the pixel on or
   //  off? The dark-on-white mode status factors into that, as does the user's
@@ -252,21 +530,223 @@ void ks0108bDrawPixel(uint8_t x, uint8_t y, PIX_VAL pixel)
     if (pixel == OFF) currentPixelData |= (1<<pixelToWrite);
     else       currentPixelData &= ~(1<<pixelToWrite);
   }
-  // Now we need to go back to the original column- the read incremented the
-  //  address counter- and write the changed value back to the display.
+  // Now put the changed value back where it came from.
+  ks0108bStore(x, page, currentPixelData);
+}
+
+// Write n whole column bytes onto one page, starting at column x. This is
+//  the fast path: the bytes line up with the page, so there's nothing to
+//  read back, and the column counter auto-increments for us, so it's at most
+//  a page and column for each chip and then nothing but data. As with drawing pixels, a set
+//  bit in src means ON, and we take care of reverse mode here. If src is 0,
+//  every byte is 'value' instead.
+static void ks0108bRun(uint8_t x, uint8_t page, const uint8_t *src,
+                       uint8_t value, uint8_t n)
+{
+  uint8_t flip = 0x00;
+  if (reverse) flip = 0xff;
+  if (page > 7) return;
+  value ^= flip;
+#if KS0108B_SHADOW_PAGES == 0
+  ks0108bSetPage(page);
+  // A fill more than half the screen wide covers some of the same columns on
+  //  both halves; those can go to both chips at once. That leaves the rest of
+  //  the left half and the start of the right half, which run on from each
+  //  other.
+  uint8_t end = ((uint16_t)x + n > 128) ? 128 : x + n;
+  if ((src == 0) && (end > x + 64))
+  {
+    ks0108bWriteBoth(x, value, end - 64 - x);
+    ks0108bSetColumn(end - 64);
+    for (uint8_t i = end - 64; i < x + 64; i++) ks0108bWriteData(value);
+    return;
+  }
   ks0108bSetColumn(x);
-  ks0108bWriteData(currentPixelData);
+  for (uint8_t i = 0; (i < n) && (x < 128); i++, x++)
+  {
+    ks0108bWriteData(src ? (src[i] ^ flip) : value);
+  }
+#else
+  for (uint8_t i = 0; (i < n) && (x < 128); i++, x++)
+  {
+    ks0108bStore(x, page, src ? (src[i] ^ flip) : value);
+  }
+#endif
+}
+
+// These two are the runs as lcd.c asks for them: y is any pixel on the page.
+void ks0108bWriteRun(uint8_t x, uint8_t y, uint8_t width, const uint8_t *src)
+{
+  ks0108bRun(x, ks0108bPage(y), src, 0, width);
+}
+
+void ks0108bFillRun(uint8_t x, uint8_t y, uint8_t width, PIX_VAL pixel)
+{
+  ks0108bRun(x, ks0108bPage(y), 0, (pixel == ON) ? 0xff : 0x00, width);
+}
+
+// Turn the bits in 'set' ON and the ones in 'clear' OFF in the column byte
+//  holding (x, y), leaving the rest of the column alone. The ks0108b has no
+//  bit set/reset of its own, so that's a read-modify-write- unless we're
+//  changing the whole byte, in which case there's no need to read it first.
+void ks0108bWriteBits(uint8_t x, uint8_t y, uint8_t set, uint8_t clear)
+{
+  uint8_t page = ks0108bPage(y);
+  uint8_t mask = set | clear;
+  uint8_t data = set;
+  if ((x > 127) || (page > 7) || (mask == 0)) return;
+  if (reverse) data ^= 0xff;
+  if (mask != 0xff) data = (ks0108bFetch(x, page) & ~mask) | (data & mask);
+  ks0108bStore(x, page, data);
+}
+
+// Read n column bytes off the page holding y, starting at column x. These
+//  come back just as they are on the glass (or in the shadow).
+void ks0108bReadBytes(uint8_t x, uint8_t y, uint8_t *dst, uint8_t n)
+{
+  uint8_t page = ks0108bPage(y);
+  for (uint8_t i = 0; i < n; i++) dst[i] = ks0108bFetch(x+i, page);
+}
+
+// ks0108bFetch() and ks0108bStore() are the read and write halves of every
+//  read-modify-write we do. Without a shadow they go straight to the glass;
+//  with one, they go to the shadow and ks0108bFlush() does the glass part
+//  later, all at once.
+#if KS0108B_SHADOW_PAGES == 0
+
+uint8_t ks0108bFetch(uint8_t x, uint8_t page)
+{
+  ks0108bSetPage(page);
+  return ks0108bReadData(x);
 }
 
+void ks0108bStore(uint8_t x, uint8_t page, uint8_t data)
+{
+  // The read (if there was one) incremented the address counter; setting
+  //  the column here gets it put back before writing.
+  ks0108bSetColumn(x);
+  ks0108bSetPage(page);
+  ks0108bWriteData(data);
+}
+
+// Nothing to do; every store has already hit the glass.
+void ks0108bFlush(void)
+{
+}
+
+#else
+
+// Write the dirty columns of one shadow slot out to the glass. Runs of dirty
+//  columns ride the controllers' column auto-increment, so ks0108bAddress()
+//  only has to set the column at the start of each run. We go across both
+//  halves together, since each chip has its own counter; where a column and
+//  its mirror on the other half are both dirty and the same (a wide fill or
+//  erase, usually), one strobe to both chips does for the pair.
+static void ks0108bFlushSlot(uint8_t slot)
+{
+  uint8_t *data = shadow[slot];
+  uint8_t *dirty = shadowDirty[slot];
+  ks0108bSetPage(shadowTag[slot]);
+  for (uint8_t x = 0; x < 64; x++)
+  {
+    uint8_t bit = 1<<(x&0x07);
+    uint8_t left = dirty[x>>3] & bit;
+    uint8_t right = dirty[(x>>3) + 8] & bit;
+    if (left && right && (data[x] == data[x+64]))
+    {
+      ks0108bWriteBoth(x, data[x], 1);
+      continue;
+    }
+    if (left)
+    {
+      ks0108bSetColumn(x);
+      ks0108bWriteData(data[x]);
+    }
+    if (right)
+    {
+      ks0108bSetColumn(x+64);
+      ks0108bWriteData(data[x+64]);
+    }
+  }
+  for (uint8_t i = 0; i < 16; i++) dirty[i] = 0;
+}
+
+// Make sure the slot that page belongs in is holding page, evicting (and
+//  flushing) whatever was there before. None of the new page's columns are
+//  loaded yet; ks0108bFetch() gets them as they're needed. Returns the slot
+//  index.
+static uint8_t ks0108bShadowSlot(uint8_t page)
+{
+  uint8_t slot = page % KS0108B_SHADOW_PAGES;
+  if (shadowTag[slot] == page) return slot;
+  if (shadowTag[slot] != 0xFF) ks0108bFlushSlot(slot);
+  shadowTag[slot] = page;
+  for (uint8_t i = 0; i < 16; i++) shadowValid[slot][i] = 0;
+  return slot;
+}
+
+uint8_t ks0108bFetch(uint8_t x, uint8_t page)
+{
+  // Off the edge of the screen; nothing there.
+  if ((x > 127) || (page > 7)) return 0;
+  uint8_t slot = ks0108bShadowSlot(page);
+  uint8_t bit = 1<<(x&0x07);
+  if ((shadowValid[slot][x>>3] & bit) == 0)
+  {
+    // If nobody has touched this page since the last clear, we already know
+    //  what's on the glass. Otherwise, we have to go read it, once.
+    if (shadowClean & (1<<page)) shadow[slot][x] = shadowFill;
+    else
+    {
+      ks0108bSetPage(page);
+      shadow[slot][x] = ks0108bReadData(x);
+    }
+    shadowValid[slot][x>>3] |= bit;
+  }
+  return shadow[slot][x];
+}
+
+// A store covers the whole byte, so the column doesn't need loading first.
+void ks0108bStore(uint8_t x, uint8_t page, uint8_t data)
+{
+  if ((x > 127) || (page > 7)) return;
+  uint8_t slot = ks0108bShadowSlot(page);
+  uint8_t bit = 1<<(x&0x07);
+  shadow[slot][x] = data;
+  shadowValid[slot][x>>3] |= bit;
+  shadowDirty[slot][x>>3] |= bit;
+  shadowClean &= ~(1<<page);
+  shadowPending = 1;
+}
+
+// Push every dirty column in the shadow out to the glass. This gets called
+//  every time the main loop comes up for air, so it needs to be cheap when
+//  there's nothing to do.
+void ks0108bFlush(void)
+{
+  if (shadowPending == 0) return;
+  shadowPending = 0;
+  for (uint8_t slot = 0; slot < KS0108B_SHADOW_PAGES; slot++)
+  {
+    if (shadowTag[slot] != 0xFF) ks0108bFlushSlot(slot);
+  }
+}
+
+#endif
+
 // I found myself typing these lines over and over, so I made them a little
 //  function of their very own.
+//  The wait after EN goes low covers the chip's cycle time; if we're polling
+//  the busy flag, the next operation checks for that itself, and all we need
+//  is enough hold time for the chip to latch the data.
 void strobeEN(void)
 {
-  _delay_us(E_DELAY);
+  ksDelay(strobeDelay);
   PORTC |= (1<<EN);        // Set EN (Indicate data ready)
-  _delay_us(E_DELAY);
+  ksDelay(strobeDelay);
   PORTC &= ~(1 << EN);      // Clear EN (Activate write)
-  _delay_us(E_DELAY);
+  if (busyPolling == 0) ksDelay(strobeDelay);
+  else                  _delay_us(1);
 }
 
 // Everytime we finish up a transfer, we want to reset the pins to a default
@@ -279,4 +759,7 @@ void setPinsDefault(void)
               (1<<CS2)|
               (1<<R_W));
   PORTC &= ~(1<<EN);
-}
\ No newline at end of file
+}
+
+// This is how lcd.c sees us; see LCD_DRIVER in glcdbp.h.
+const LCD_DRIVER ks0108bDriver PROGMEM = KS0108B_DRIVER;
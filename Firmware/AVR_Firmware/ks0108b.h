@@ -16,6 +16,16 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 #ifndef __ks0108b_h
 #define __ks0108b_h
 
+// Number of pages of the display to mirror in RAM. 0 turns the shadow off
+//  and every pixel is a read-modify-write against the glass; 8 mirrors the
+//  whole screen; anything in between gives a sliding window of pages. Each
+//  page costs 161 bytes, so the ATmega168, with the serial rings taking 288
+//  of its 1K, only has room for 1 or 2; 4 and 8 are for parts with more
+//  SRAM, like the ATmega328. Normally set from the Makefile.
+#ifndef KS0108B_SHADOW_PAGES
+#define KS0108B_SHADOW_PAGES 0
+#endif
+
 void     ks0108bWriteData(uint8_t data);
 void     ks0108bReadBlock(uint8_t address, uint8_t y, uint8_t *buffer);
 uint8_t  ks0108bReadData(uint8_t x);
@@ -23,11 +33,30 @@ void     ks0108bSetColumn(uint8_t address);
 void     ks0108bSetPage(uint8_t address);
 void     ks0108bDisplayOn(void);
 void     ks0108bReset(void);
-void     ks0108bSetStartLine(void);
+void     ks0108bSetStartLine(uint8_t line);
+void     ks0108bScroll(void);
 void     strobeEN(void);
 void     ks0108bClear(void);
 void     setPinsDefault(void);
 void     ks0108bDrawPixel(uint8_t x, uint8_t y, PIX_VAL pixel);
+uint8_t  ks0108bFetch(uint8_t x, uint8_t page);
+void     ks0108bStore(uint8_t x, uint8_t page, uint8_t data);
+void     ks0108bFlush(void);
+void     ks0108bInit(void);
+void     ks0108bCalibrate(void);
+void     ks0108bWriteRun(uint8_t x, uint8_t y, uint8_t width, const uint8_t *src);
+void     ks0108bFillRun(uint8_t x, uint8_t y, uint8_t width, PIX_VAL pixel);
+void     ks0108bWriteBits(uint8_t x, uint8_t y, uint8_t set, uint8_t clear);
+void     ks0108bReadBytes(uint8_t x, uint8_t y, uint8_t *dst, uint8_t n);
+
+// The driver descriptor (see LCD_DRIVER in glcdbp.h). It's spelled out here,
+//  rather than only in ks0108b.c, so that a build for just this display can
+//  hand it to lcd.c as a constant and let the compiler call straight through.
+#define KS0108B_DRIVER {128, 64, LAYOUT_COLUMNS, ks0108bInit, ks0108bClear, \
+                        ks0108bFlush, ks0108bReadBytes, ks0108bWriteBits,  \
+                        ks0108bWriteRun, ks0108bFillRun, ks0108bReadBlock, \
+                        0, 0, 0, ks0108bScroll, 0}
+extern const LCD_DRIVER ks0108bDriver;
 
 #endif
 
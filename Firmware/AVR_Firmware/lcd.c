@@ -22,10 +22,12 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 #include "ks0108b.h"
 #include "serial.h"
 #include "t6963.h"
+#ifdef VIRTUAL_LCD
+#include "vlcd.h"
+#endif
 
-// These variables are defined in glcdbp.c, and allow us to take actions based
-//  on the type of display and the operating mode (reverse or normal).
-extern enum DISPLAY_TYPE display;
+// This is defined in glcdbp.c, and lets us take actions based on the
+//  operating mode (reverse or normal). 'display' comes from glcdbp.h.
 extern volatile uint8_t reverse;
 
 // These values allow us to emulate a terminal of arbitrary size. cursorPos is
@@ -37,6 +39,13 @@ uint8_t  cursorPos[] = {0,0};
 uint8_t  textOrigin[] = {0,0};
 uint16_t textLength = 0; // Number of characters typed since last time we set
                          //  cursorPos to textOrigin. Facilitates backspace.
+uint8_t  charWidth = 6;  // Distance from one character to the next. Our own
+                         //  font is 5 pixels plus a space; the t6963's text
+                         //  layer uses 8x8 cells.
+uint8_t  textLayer = TEXT_OFF; // Is the t6963 text layer in use, and if so,
+                               //  how is it combined with the graphics?
+uint8_t  textScroll = 0; // When the text runs off the bottom, scroll the
+                         //  screen up (1) or go back to the top (0)?
 
 // Because we have two different types of display, it's nice to be able to 
 //  not hard-code the dimensions in cases where we may want to set limits or
@@ -44,24 +53,223 @@ uint16_t textLength = 0; // Number of characters typed since last time we set
 uint8_t  xDim = 128;
 uint8_t  yDim = 64;
 
-// Configure functions for the two display types. The details are in the
+// Drawing only happens inside the clip rectangle (edges included), so a host
+//  can fence a widget off from the rest of the screen. It starts out as the
+//  whole screen; it never extends past the edges, so anything that's inside
+//  it is on the screen, too. Clearing the screen ignores it.
+uint8_t  clipX0 = 0;
+uint8_t  clipY0 = 0;
+uint8_t  clipX1 = 127;
+uint8_t  clipY1 = 63;
+
+// The driver we draw with (see LCD_DRIVER in glcdbp.h). Everything in here
+//  that touches the display goes through this, so a new kind of display only
+//  needs a new driver, not changes all over this file. Normally lcdConfig()
+//  copies the right one out of flash once we know which display we've got;
+//  a single-display build already knows, so there the driver is a constant
+//  and the compiler calls straight through to its functions.
+#if defined(ONLY_KS0108B)
+static const LCD_DRIVER lcdDriver = KS0108B_DRIVER;
+#elif defined(ONLY_T6963)
+static const LCD_DRIVER lcdDriver = T6963_DRIVER;
+#else
+static LCD_DRIVER lcdDriver;
+#endif
+
+// With VIRTUAL_LCD defined, there's no display at all: we draw into the
+//  virtual panel in vlcd.c instead, shaped like whichever display 'display'
+//  says we have.
+#ifdef VIRTUAL_LCD
+#define SMALL_DRIVER vlcdSmallDriver
+#define LARGE_DRIVER vlcdLargeDriver
+#else
+#define SMALL_DRIVER ks0108bDriver
+#define LARGE_DRIVER t6963Driver
+#endif
+
+// Pick a driver and start the display up. The details are in the
 //  appropriate driver files.
 void lcdConfig(void)
 {
+#ifndef DISPLAY_FIXED
   if (display == SMALL)
+    memcpy_P(&lcdDriver, &SMALL_DRIVER, sizeof(LCD_DRIVER));
+  else
+    memcpy_P(&lcdDriver, &LARGE_DRIVER, sizeof(LCD_DRIVER));
+#endif
+  lcdDriver.init();
+  xDim = lcdDriver.width;
+  yDim = lcdDriver.height;
+  lcdSetClip(0, 0, 255, 255);
+}
+
+// Set the clip rectangle. The corners can come in either order, and anything
+//  past the edge of the screen gets pulled back to it.
+void lcdSetClip(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+  uint8_t temp;
+  if (x1 < x0)
+  {
+    temp = x0;
+    x0 = x1;
+    x1 = temp;
+  }
+  if (y1 < y0)
+  {
+    temp = y0;
+    y0 = y1;
+    y1 = temp;
+  }
+  if (x0 >= xDim) x0 = xDim - 1;
+  if (x1 >= xDim) x1 = xDim - 1;
+  if (y0 >= yDim) y0 = yDim - 1;
+  if (y1 >= yDim) y1 = yDim - 1;
+  clipX0 = x0;
+  clipY0 = y0;
+  clipX1 = x1;
+  clipY1 = y1;
+}
+
+// Pixels get written a byte at a time: as long as they keep landing in the
+//  same display byte (one page of one column on the ks0108b, 8 pixels of one
+//  row on the t6963), we just collect which bits to turn on and which to turn
+//  off, and only go out to the display when a pixel lands somewhere else or
+//  the drawing command is done. A steep line on the ks0108b goes down a
+//  column, so that's one read and one write per page instead of per pixel.
+#define COMBINE_NONE 0xffff
+static uint16_t combineAddr = COMBINE_NONE; // Which byte we're collecting.
+static uint8_t  combineX;                   // A pixel in that byte.
+static uint8_t  combineY;
+static uint8_t  combineSet;                 // Bits to turn ON...
+static uint8_t  combineClear;               // ...and bits to turn OFF.
+
+// Write out whatever we've collected. Anything that draws to the display
+//  without going through lcdCombine() has to do this first, or the pixels
+//  would land out of order.
+static void lcdCombineFlush(void)
+{
+  if (combineAddr == COMBINE_NONE) return;
+  lcdDriver.writeBits(combineX, combineY, combineSet, combineClear);
+  combineAddr = COMBINE_NONE;
+  combineSet = 0;
+  combineClear = 0;
+}
+
+static void lcdCombine(uint8_t x, uint8_t y, PIX_VAL pixel)
+{
+  uint16_t addr;
+  uint8_t  bit;
+  if (lcdDriver.layout == LAYOUT_COLUMNS)
+  {
+    addr = ((y/8)<<8) | x;
+    bit = 1<<(y%8);
+  }
+  else
+  {
+    addr = ((uint16_t)y<<8) | (x>>3);
+    bit = 0x80>>(x%8);
+  }
+  if (addr != combineAddr)
   {
-    ks0108bReset();
-    ks0108bDisplayOn();
-    ks0108bClear();
-    xDim = 128;
-    yDim = 64;
+    lcdCombineFlush();
+    combineAddr = addr;
+    combineX = x;
+    combineY = y;
+  }
+  if (pixel == ON)
+  {
+    combineSet |= bit;
+    combineClear &= ~bit;
   }
   else
   {
-    t6963DisplayInit();
-    xDim = 160;
-    yDim = 128;
+    combineClear |= bit;
+    combineSet &= ~bit;
+  }
+}
+
+// Turn on a pixel, if it's inside the clip rectangle. The coordinates are
+//  signed, so a circle can hang off the top or left of the screen without
+//  wrapping around to the other side. Call lcdCombineFlush() when done.
+static void lcdPlot(int16_t x, int16_t y)
+{
+  if ((x < clipX0) || (x > clipX1) || (y < clipY0) || (y > clipY1)) return;
+  lcdCombine(x, y, ON);
+}
+
+// Cohen-Sutherland line clipping. Each end of the line gets a code saying
+//  which sides of the clip rectangle it's outside of; if both ends are
+//  outside the same side, none of the line is visible, and if neither end is
+//  outside anything, all of it is. Otherwise, we slide an outside end along
+//  the line to the edge it's past and try again.
+#define CLIP_LEFT   0x01
+#define CLIP_RIGHT  0x02
+#define CLIP_TOP    0x04
+#define CLIP_BOTTOM 0x08
+
+static uint8_t lcdOutCode(int16_t x, int16_t y)
+{
+  uint8_t code = 0;
+  if (x < clipX0)      code |= CLIP_LEFT;
+  else if (x > clipX1) code |= CLIP_RIGHT;
+  if (y < clipY0)      code |= CLIP_TOP;
+  else if (y > clipY1) code |= CLIP_BOTTOM;
+  return code;
+}
+
+// Clip the line in place. Returns 0 if there's nothing left to draw.
+static uint8_t lcdClipLine(uint8_t *p1x, uint8_t *p1y, uint8_t *p2x,
+                           uint8_t *p2y)
+{
+  int16_t x1 = *p1x, y1 = *p1y, x2 = *p2x, y2 = *p2y;
+  uint8_t code1 = lcdOutCode(x1, y1);
+  uint8_t code2 = lcdOutCode(x2, y2);
+  while (code1 | code2)
+  {
+    if (code1 & code2) return 0;
+    uint8_t code = code1 ? code1 : code2;
+    int16_t x, y;
+    // The products here can be bigger than an int16_t will hold. We can't
+    //  divide by zero: if the line were parallel to the edge we're clipping
+    //  against, both ends would be past it, and we'd be gone already.
+    if (code & CLIP_BOTTOM)
+    {
+      x = x1 + ((int32_t)(x2 - x1) * (clipY1 - y1)) / (y2 - y1);
+      y = clipY1;
+    }
+    else if (code & CLIP_TOP)
+    {
+      x = x1 + ((int32_t)(x2 - x1) * (clipY0 - y1)) / (y2 - y1);
+      y = clipY0;
+    }
+    else if (code & CLIP_RIGHT)
+    {
+      y = y1 + ((int32_t)(y2 - y1) * (clipX1 - x1)) / (x2 - x1);
+      x = clipX1;
+    }
+    else
+    {
+      y = y1 + ((int32_t)(y2 - y1) * (clipX0 - x1)) / (x2 - x1);
+      x = clipX0;
+    }
+    if (code == code1)
+    {
+      x1 = x;
+      y1 = y;
+      code1 = lcdOutCode(x1, y1);
+    }
+    else
+    {
+      x2 = x;
+      y2 = y;
+      code2 = lcdOutCode(x2, y2);
+    }
   }
+  *p1x = x1;
+  *p1y = y1;
+  *p2x = x2;
+  *p2y = y2;
+  return 1;
 }
 
 // Reset our text mode, then call the driver specific clear screen command.
@@ -70,8 +278,53 @@ void lcdClearScreen(void)
   cursorPos[0] = textOrigin[0];
   cursorPos[1] = textOrigin[1];
   textLength = 0;
-  if (display == SMALL)	ks0108bClear();
-  else t6963Clear();
+  lcdDriver.clear();
+  if (textLayer != TEXT_OFF) lcdDriver.clearText();
+}
+
+// Turn scrolling text on or off. With it on, text that runs off the bottom
+//  of the screen moves the whole screen up a line, rather than starting over
+//  at the top of the text area. That only works if the driver can scroll;
+//  if it can't, we quietly keep wrapping.
+void lcdSetScroll(uint8_t on)
+{
+  textScroll = (on != 0);
+}
+
+// Move the text cursor to the start of the next line. If that's off the
+//  bottom of the screen, either scroll everything up to make room (the
+//  cursor stays on the bottom line) or wrap to the top of the text area.
+static void lcdNewLine(void)
+{
+  cursorPos[0] = textOrigin[0];
+  cursorPos[1] += 8;
+  if (cursorPos[1] < (yDim-7)) return;
+  if (textScroll && (textLayer != TEXT_OFF) && lcdDriver.scrollText)
+  {
+    lcdDriver.scrollText();
+    cursorPos[1] -= 8;
+  }
+  else if (textScroll && (textLayer == TEXT_OFF) && lcdDriver.scroll)
+  {
+    lcdDriver.scroll();
+    cursorPos[1] -= 8;
+  }
+  else cursorPos[1] = textOrigin[1];
+}
+
+// Switch the t6963 text layer on (TEXT_OR, TEXT_XOR or TEXT_AND) or off
+//  (TEXT_OFF). A display with no such thing (the ks0108b) ignores it. The
+//  text cursor goes back to the text origin, since the character size changes.
+void lcdSetTextLayer(uint8_t mode)
+{
+  if ((lcdDriver.textMode == 0) || (mode > TEXT_AND)) return;
+  textLayer = mode;
+  if (mode == TEXT_OFF) charWidth = 6;
+  else                  charWidth = 8;
+  lcdDriver.textMode(mode);
+  cursorPos[0] = textOrigin[0];
+  cursorPos[1] = textOrigin[1];
+  textLength = 0;
 }
 
  // Draws a line between two points p1(p1x,p1y) and p2(p2x,p2y).
@@ -91,6 +344,10 @@ void lcdDrawLine(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pix
 {
     int16_t F, x, y;
 
+    // Trim the line to the clip rectangle first, so we don't spend time
+    //  working out pixels that can't be drawn.
+    if (lcdClipLine(&p1x, &p1y, &p2x, &p2y) == 0) return;
+
     if (p1x > p2x)  // Swap points if p1 is on the right of p2
     {
       x = p1x;
@@ -101,36 +358,12 @@ void lcdDrawLine(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pix
       p2y = y;
     }
 
-    // Handle trivial cases separately for algorithm speed up.
-    // Trivial case 1: m = +/-INF (Vertical line)
-    if (p1x == p2x)
+    // Handle trivial cases separately for algorithm speed up. Vertical and
+    //  horizontal lines are just rectangles one pixel wide, and those we can
+    //  fill a byte at a time.
+    if ((p1x == p2x) || (p1y == p2y))
     {
-        if (p1y > p2y)  // Swap y-coordinates if p1 is above p2
-        {
-          y = p1y;
-          p1y = p2y;
-          p2y = y;
-        }
-        x = p1x;
-        y = p1y;
-        while (y <= p2y)
-        {
-          lcdDrawPixel(x, y, ON);
-          y++;
-        }
-        return;
-    }
-    // Trivial case 2: m = 0 (Horizontal line)
-    else if (p1y == p2y)
-    {
-        x = p1x;
-        y = p1y;
-
-        while (x <= p2x)
-        {
-          lcdDrawPixel(x, y, ON);
-          x++;
-        }
+        lcdFillRect(p1x, p1y, p2x, p2y, ON);
         return;
     }
 
@@ -153,7 +386,7 @@ void lcdDrawLine(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pix
             y = p1y;
             while (x <= p2x)
             {
-                lcdDrawPixel(x, y, ON);
+                lcdPlot(x, y);
                 if (F <= 0)
                 {
                     F += dy2;
@@ -176,7 +409,7 @@ void lcdDrawLine(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pix
             x = p1x;
             while (y <= p2y)
             {
-                lcdDrawPixel(x, y, ON);
+                lcdPlot(x, y);
                 if (F <= 0)
                 {
                     F += dx2;
@@ -201,7 +434,7 @@ void lcdDrawLine(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pix
             y = p1y;
             while (x <= p2x)
             {
-                lcdDrawPixel(x, y, ON);
+                lcdPlot(x, y);
                 if (F <= 0)
                 {
                     F -= dy2;
@@ -224,7 +457,7 @@ void lcdDrawLine(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pix
             x = p1x;
             while (y >= p2y)
             {
-                lcdDrawPixel(x, y, ON);
+                lcdPlot(x, y);
                 if (F <= 0)
                 {
                     F += dx2;
@@ -238,28 +471,59 @@ void lcdDrawLine(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pix
             }
         }
     }
+    lcdCombineFlush();
+}
+
+// Does the box from (xa, ya) to (xb, yb) overlap the clip rectangle at all?
+static uint8_t lcdClipBox(int16_t xa, int16_t ya, int16_t xb, int16_t yb)
+{
+  return !((xb < clipX0) || (xa > clipX1) || (yb < clipY0) || (ya > clipY1));
 }
 
 // I found this code on wikipedia- it's the general circle version of
 //  Bresenham's line algorithm. It works great. I'm not going to attempt to
 //  comment it- look it up yourself, lazy.
+// What I *will* comment is the clipping. Each of the eight points we draw per
+//  step traces out one octant of the circle, and each octant stays inside a
+//  box we can work out up front; if that box misses the clip rectangle, we
+//  never draw that octant at all. For a big circle mostly off the screen,
+//  that's most of the work gone.
 void lcdDrawCircle(uint8_t x0, uint8_t y0, uint8_t r, PIX_VAL pixel)
 {
-  int x = r, y = 0;
-  int xChange = 1 - (r << 1);
-  int yChange = 0;
-  int radiusError = 0;
+  int16_t x = r, y = 0;
+  int16_t xChange = 1 - (r << 1);
+  int16_t yChange = 0;
+  int16_t radiusError = 0;
+  
+  // Along an octant, one coordinate runs from 0 to r/sqrt(2) (c is a bit more
+  //  than that), and the other from r down to r/sqrt(2) (m is a bit less).
+  //  r * 181 needs all 16 bits once r gets past 181, so a 16-bit int would
+  //  go negative; it has to be unsigned. Cutting it back to 16 bits does
+  //  nothing on the AVR, but it makes the host build do the same sum, so the
+  //  check suite (host/bench.c) would catch it going wrong.
+  int16_t c = ((uint16_t)((uint16_t)r * 181) >> 8) + 1;
+  int16_t m = (c > 2) ? c - 2 : 0;
+  uint8_t octants = 0;
+  if (lcdClipBox(x0 + m, y0,     x0 + r, y0 + c)) octants |= 0x01;
+  if (lcdClipBox(x0,     y0 + m, x0 + c, y0 + r)) octants |= 0x02;
+  if (lcdClipBox(x0 - r, y0,     x0 - m, y0 + c)) octants |= 0x04;
+  if (lcdClipBox(x0 - c, y0 + m, x0,     y0 + r)) octants |= 0x08;
+  if (lcdClipBox(x0 - r, y0 - c, x0 - m, y0    )) octants |= 0x10;
+  if (lcdClipBox(x0 - c, y0 - r, x0,     y0 - m)) octants |= 0x20;
+  if (lcdClipBox(x0 + m, y0 - c, x0 + r, y0    )) octants |= 0x40;
+  if (lcdClipBox(x0,     y0 - r, x0 + c, y0 - m)) octants |= 0x80;
+  if (octants == 0) return;
  
   while(x >= y)
   {
-    lcdDrawPixel(x + x0, y + y0, ON);
-    lcdDrawPixel(y + x0, x + y0, ON);
-    lcdDrawPixel(-x + x0, y + y0, ON);
-    lcdDrawPixel(-y + x0, x + y0, ON);
-    lcdDrawPixel(-x + x0, -y + y0, ON);
-    lcdDrawPixel(-y + x0, -x + y0, ON);
-    lcdDrawPixel(x + x0, -y + y0, ON);
-    lcdDrawPixel(y + x0, -x + y0, ON);
+    if (octants & 0x01) lcdPlot(x0 + x, y0 + y);
+    if (octants & 0x02) lcdPlot(x0 + y, y0 + x);
+    if (octants & 0x04) lcdPlot(x0 - x, y0 + y);
+    if (octants & 0x08) lcdPlot(x0 - y, y0 + x);
+    if (octants & 0x10) lcdPlot(x0 - x, y0 - y);
+    if (octants & 0x20) lcdPlot(x0 - y, y0 - x);
+    if (octants & 0x40) lcdPlot(x0 + x, y0 - y);
+    if (octants & 0x80) lcdPlot(x0 + y, y0 - x);
  
     y++;
     radiusError += yChange;
@@ -271,6 +535,7 @@ void lcdDrawCircle(uint8_t x0, uint8_t y0, uint8_t r, PIX_VAL pixel)
       xChange += 2;
     }
   }
+  lcdCombineFlush();
 }
 
 // Draw box is just four lines. It's really just a shortcut.
@@ -282,8 +547,10 @@ void lcdDrawBox(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pixe
 	lcdDrawLine(p2x, p2y, p2x, p1y, pixel);
 }
 
-// This is the by-pixel character rendering function. At this point, there's no
-//  support for the t6963 built-in character generator. Get on that, won't you?
+// This is the character rendering function. Normally, characters are drawn
+//  into the graphics from our own font. On the t6963, if the text layer has
+//  been turned on, we use the built-in character generator instead; the
+//  cursor still moves in pixels, but characters land on 8x8 cells.
 void lcdDrawChar(char printMe)
 {
   // So, we'll check our three special cases first: backspace and newline.
@@ -292,19 +559,17 @@ void lcdDrawChar(char printMe)
     case '\r':  // Newline.
     // For backspace tracking purposes, we want to track how many characters
     //  we're skipping on this line.
-    while (cursorPos[0] <= (xDim-6))
+    while (cursorPos[0] <= (xDim-charWidth))
     {
-      cursorPos[0] += 6;
+      cursorPos[0] += charWidth;
       textLength++;
     }
     // Then, we want to reset the imaginary cursor to the start of the next
-    //  "line" of text- 8 pixels below the top of the current line.
-    cursorPos[0] = textOrigin[0];
-    cursorPos[1] += 8;
-    // If we've reached the bottom of the screen, we want to wrap to the top
+    //  "line" of text- 8 pixels below the top of the current line. If we've
+    //  reached the bottom of the screen, we either scroll or wrap to the top
     //  of the area that we defined to contain text by setting the text origin
     //  at some earlier time.
-    if (cursorPos[1] >= (yDim-7)) cursorPos[1] = textOrigin[1];
+    lcdNewLine();
     break;
     
     case '\b':
@@ -326,31 +591,29 @@ void lcdDrawChar(char printMe)
         if (cursorPos[1] == textOrigin[1])
         {
           while (cursorPos[1] < (yDim-8)) cursorPos[1] +=8;
-          while (cursorPos[0] <= (xDim-6)) cursorPos[0] += 6;
-          cursorPos[0]-=6;
+          while (cursorPos[0] <= (xDim-charWidth)) cursorPos[0] += charWidth;
+          cursorPos[0]-=charWidth;
         }
         else // Not at the top of the block, just the start of the line.
         {
           cursorPos[1] -= 8;
-          while (cursorPos[0] <= (xDim-6)) cursorPos[0] += 6;
-          cursorPos[0]-=6;
+          while (cursorPos[0] <= (xDim-charWidth)) cursorPos[0] += charWidth;
+          cursorPos[0]-=charWidth;
         }
       }
       // Normal case: not at the left or top edge of the block
       else
       {
-        cursorPos[0] -= 6;
+        cursorPos[0] -= charWidth;
       } 
       
       // Now that our cursor is where it ought to be, we can blank out the
       //   current character location by turning the pixels there off.
-      for (uint8_t x = cursorPos[0]; x<cursorPos[0]+5; x++)
-      {
-        for (uint8_t y = cursorPos[1]; y<cursorPos[1]+8; y++)
-        {
-          lcdDrawPixel(x,y,OFF);
-        }
-      }
+      if (lcdDriver.writeText && (textLayer != TEXT_OFF))
+        lcdDriver.writeText(cursorPos[0]>>3, cursorPos[1]>>3, ' ');
+      else
+        lcdEraseBlock(cursorPos[0], cursorPos[1],
+                      cursorPos[0]+4, cursorPos[1]+7);
     }
     break;
   }
@@ -367,26 +630,55 @@ void lcdDrawChar(char printMe)
 		charOffset=5*charOffset;
     textLength++;
     
-    // This is the arbitrary character generator. For this, cursorPos is the
-    //   upper left of the character, and we'll draw it pixel by pixel, one
-    //   column at a time. It's slower, but more flexible.
-    for (uint8_t x = cursorPos[0]; x<cursorPos[0]+5; x++)
+    if (lcdDriver.writeText && (textLayer != TEXT_OFF))
     {
-      uint8_t colTemp = pgm_read_byte(&characterArray[charOffset++]);
-      for (uint8_t y = cursorPos[1]; y<cursorPos[1]+8; y++)
+      // The controller does all the work; we just tell it which cell.
+      lcdDriver.writeText(cursorPos[0]>>3, cursorPos[1]>>3, printMe);
+    }
+    else if (lcdDriver.layout == LAYOUT_ROWS)
+    {
+      // The t6963 wants rows, and we have a copy of the font that's already
+      //  been turned on its side, so each row of the character (including
+      //  the blank column after it) is a single byte. We do our own
+      //  clipping: bits come off the left of each row byte, the width comes
+      //  in on the right, and rows outside the clip rectangle get skipped.
+      uint16_t rowOffset = (printMe - ' ')*8;
+      uint8_t x = cursorPos[0];
+      uint8_t skip = 0;
+      uint8_t width = 6;
+      if (x < clipX0)
+      {
+        skip = clipX0 - x;
+        x = clipX0;
+        width = (skip < 6) ? 6 - skip : 0;
+      }
+      if (x > clipX1) width = 0;
+      else if (width > (clipX1 - x + 1)) width = clipX1 - x + 1;
+      for (uint8_t y = 0; (y<8) && (width != 0); y++)
       {
-        if ((colTemp>>(y-cursorPos[1]))&0x01) lcdDrawPixel(x,y,ON);
-        else lcdDrawPixel(x,y,OFF);
+        uint8_t row = cursorPos[1]+y;
+        if ((row < clipY0) || (row > clipY1)) continue;
+        uint8_t rowTemp = pgm_read_byte(&characterRows[rowOffset+y])<<skip;
+        lcdDriver.writeRun(x, row, width, &rowTemp);
       }
     }
-    cursorPos[0] += 6;  // Increment our x position by one character space.
-    // if we're at the end of the line, we need to wrap to the next line.
-    if (cursorPos[0] >= (xDim-6))
+    else
     {
-      cursorPos[0] = textOrigin[0];
-      cursorPos[1] += 8;
-      if (cursorPos[1] >= (yDim-7)) cursorPos[1] = textOrigin[1];
+      // This is the arbitrary character generator. For this, cursorPos is
+      //   the upper left of the character. The glyph is five columns, plus a
+      //   blank one for spacing, and that's exactly what lcdDrawColumns()
+      //   eats.
+      uint8_t glyph[6];
+      for (uint8_t i = 0; i<5; i++)
+      {
+        glyph[i] = pgm_read_byte(&characterArray[charOffset++]);
+      }
+      glyph[5] = 0;
+      lcdDrawColumns(cursorPos[0], cursorPos[1], glyph, 6, 8);
     }
+    cursorPos[0] += charWidth;  // Increment our x position by one character space.
+    // if we're at the end of the line, we need to wrap to the next line.
+    if (cursorPos[0] > (xDim-charWidth)) lcdNewLine();
 	}	
 }
 
@@ -415,125 +707,106 @@ void lcdDrawSprite(uint8_t x, uint8_t y, uint8_t sprite, char angle,
       buffer[i-spriteIndex] &= pgm_read_byte(&maskArray[i]);
       buffer[i-spriteIndex] |= pgm_read_byte(&spriteArray[i]);
     }
-    // The buffer now holds the block as it should look. Now we need to print
-    //  it, pixel by pixel, to the screen. I'm not going to go into the
-    //  nitty gritty details of how I figured this out- suffice it to say,
-    //  graph paper was involved.
-    switch(angle)
+    // The buffer now holds the block as it should look. Now we need to turn
+    //  it to the requested angle; what comes out is a set of columns, bit 0
+    //  at the top, that lcdDrawColumns() can put on the screen. I'm not going
+    //  to go into the nitty gritty details of how I figured this out-
+    //  suffice it to say, graph paper was involved.
+    uint8_t cols[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (uint8_t i = 0; i<8; i++)
     {
-      case '0':
-      for (uint8_t i = 0; i<8; i++)
-      {
-        for (uint8_t j = 0; j<8; j++)
-        {
-          if (pixel == ON)
-          {
-            if (buffer[i]&0x01) lcdDrawPixel(x+i,y+7-j,ON);
-            else lcdDrawPixel(x+i,y+7-j,OFF);
-          }
-          else
-          {
-            if (buffer[i]&0x01) lcdDrawPixel(x+i,y+7-j,OFF);
-            else lcdDrawPixel(x+i,y+7-j,ON);
-          }
-          buffer[i] = buffer[i]>>1;
-        }
-      }
-      break;
-      case '3':
-      for (uint8_t i = 0; i<8; i++)
-      {
-        for (uint8_t j = 0; j<8; j++)
-        {
-          if (pixel == ON)
-          {
-            if (buffer[i]&0x01) lcdDrawPixel(x+j,y+i,ON);
-            else lcdDrawPixel(x+j,y+i,OFF);
-          }
-          else
-          {
-            if (buffer[i]&0x01) lcdDrawPixel(x+j,y+i,OFF);
-            else lcdDrawPixel(x+j,y+i,ON);
-          }
-          buffer[i] = buffer[i]>>1;
-        }
-      }
-      break;
-      case '6':
-      for (uint8_t i = 0; i<8; i++)
+      for (uint8_t j = 0; j<8; j++)
       {
-        for (uint8_t j = 0; j<8; j++)
+        // If we're drawing with OFF pixels, the sprite goes in as a negative.
+        uint8_t bit = buffer[i]&0x01;
+        if (pixel == OFF) bit ^= 0x01;
+        buffer[i] = buffer[i]>>1;
+        if (bit == 0) continue;
+        switch(angle)
         {
-          if (pixel == ON)
-          {
-            if (buffer[i]&0x01) lcdDrawPixel(x+7-i,y+j,ON);
-            else lcdDrawPixel(x+7-i,y+j,OFF);
-          }
-          else
-          {
-            if (buffer[i]&0x01) lcdDrawPixel(x+7-i,y+j,OFF);
-            else lcdDrawPixel(x+7-i,y+j,ON);
-          }
-          buffer[i] = buffer[i]>>1;
+          case '0': cols[i]   |= 0x80>>j; break;  // (x+i, y+7-j)
+          case '3': cols[j]   |= 0x01<<i; break;  // (x+j, y+i)
+          case '6': cols[7-i] |= 0x01<<j; break;  // (x+7-i, y+j)
+          case '9': cols[7-j] |= 0x80>>i; break;  // (x+7-j, y+7-i)
         }
       }
-      break;
-      case '9':
-      for (uint8_t i = 0; i<8; i++)
-      {
-        for (uint8_t j = 0; j<8; j++)
-        {
-          if (pixel == ON)
-          {
-            if (buffer[i]&0x01) lcdDrawPixel(x+7-j,y+7-i,ON);
-            else lcdDrawPixel(x+7-j,y+7-i,OFF);
-          }
-          else
-          {
-            if (buffer[i]&0x01) lcdDrawPixel(x+7-j,y+7-i,OFF);
-            else lcdDrawPixel(x+7-j,y+7-i,ON);
-          }
-          buffer[i] = buffer[i]>>1;
-        }
-      }
-      break;
     }
+    // Any other angle is nonsense; draw nothing, same as we always have.
+    if ((angle == '0') || (angle == '3') || (angle == '6') || (angle == '9'))
+      lcdDrawColumns(x, y, cols, 8, 8);
   }
 
-// This function has room for lots of improvement. We draw over the block to
-//   be erased pixel by pixel, but we *could* do it column by column on the
-//   ks0108b or row by row on the t6963.
-void lcdEraseBlock(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+// Write the bits of data picked out by mask into the display byte holding
+//  (x, y), and leave the rest of it alone.
+static void lcdWriteMasked(uint8_t x, uint8_t y, uint8_t data, uint8_t mask)
+{
+  if (mask) lcdDriver.writeBits(x, y, data & mask, ~data & mask);
+}
+
+// Fill a rectangle (corners in either order, edges included) with ON or OFF
+//  pixels, a whole byte at a time wherever we can. On a column display (the
+//  ks0108b), a page the rectangle covers top to bottom is a single run of
+//  writes; only the top and bottom pages, where it covers part of a byte,
+//  need reading back. On a row display (the t6963), each row is one burst.
+//  This is what horizontal and vertical lines, boxes and block erases all
+//  come down to.
+void lcdFillRect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, PIX_VAL pixel)
 {
-  // We want to go from upper left to lower right- if some degenerate user
-  //   thinks to be cute, we want to make sure that our points are redefined
-  //   so that (x0,y0) is the upper left, and (x1,y1) is lower right.
+  uint8_t temp;
   if (x1<x0)
   {
-    uint8_t xTemp = x0;
+    temp = x0;
     x0 = x1;
-    x1 = xTemp;
+    x1 = temp;
   }
   if (y1<y0)
   {
-    uint8_t yTemp = y0;
+    temp = y0;
     y0 = y1;
-    y1 = yTemp;
+    y1 = temp;
   }
-  // Now that we've got that settled, we'll start at point (x0,y0) and just
-  //   use the lcdPixelDraw() function to turn off each pixel in the block.
-  //   We'll do this by defining points (i,j), iterating across in x, then
-  //   down y.
-  for (uint8_t j = y0; j <= y1; j++)
+  // Parts of the block outside the clip rectangle just get dropped.
+  if ((x0 > clipX1) || (y0 > clipY1) || (x1 < clipX0) || (y1 < clipY0)) return;
+  if (x0 < clipX0) x0 = clipX0;
+  if (y0 < clipY0) y0 = clipY0;
+  if (x1 > clipX1) x1 = clipX1;
+  if (y1 > clipY1) y1 = clipY1;
+  uint8_t width = x1 - x0 + 1;
+  
+  if (lcdDriver.layout == LAYOUT_ROWS)
   {
-    for (uint8_t i = x0; i <= x1; i++)
+    for (uint8_t j = y0; j <= y1; j++)
     {
-      lcdDrawPixel(i,j,OFF);
+      lcdDriver.fillRun(x0, j, width, pixel);
     }
+    return;
   }
+  
+  uint8_t value = (pixel == ON) ? 0xff : 0x00;
+  for (uint8_t page = y0/8; page <= y1/8; page++)
+  {
+    // Which bits of this page does the rectangle cover?
+    uint8_t mask = 0xff;
+    if (page == y0/8) mask &= 0xff<<(y0%8);
+    if (page == y1/8) mask &= 0xff>>(7-(y1%8));
+    if (mask == 0xff) lcdDriver.fillRun(x0, page*8, width, pixel);
+    else
+    {
+      for (uint8_t i = 0; i < width; i++)
+      {
+        lcdWriteMasked(x0+i, page*8, value, mask);
+      }
+    }
+  }
+}
+
+// Erase a block, which is to say, fill it with the background color.
+void lcdEraseBlock(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+  lcdFillRect(x0, y0, x1, y1, OFF);
 }
 
-// Draw the SparkFun logo, pixel by pixel. We do this as a splash screen.
+// Draw the SparkFun logo. We do this as a splash screen.
 void lcdDrawLogo(void)
 {
   // x and y are the left and top edges of the logo. We want to center the
@@ -541,72 +814,215 @@ void lcdDrawLogo(void)
   //  screen is 10 pixels to far to the right and 8 pixels to far down.
   uint8_t x = ((xDim/2)-10);
   uint8_t y  = ((yDim/2)-8);
+  uint8_t cols[20];
 
-  // Now we're going to iterate over the bytes in the logo array, starting
-  //  with the top half. The logo is stored with the 10 bytes forming the
-  //  top half first in memory, then the 10 for the bottom half next.
-  for (uint8_t i = 0; i<10; i++)
+  // The logo is stored with the 10 column bytes forming the top half first
+  //  in memory, then the 10 for the bottom half next. The logo always looks
+  //  the same on the glass, regardless of the 'reverse' flag, so in reverse
+  //  mode we hand over the negative and let the driver flip it back.
+  for (uint8_t i = 0; i<20; i++)
   {
-    // Pull in the next byte of the logo.
-    uint8_t colTemp = pgm_read_byte(&logoArray[i]);
-    // Iterate over the bits in that byte, drawing one pixel at a time by
-    //  looking at the lowest bit in the byte, and drawing according to
-    //  that pixel and the 'reverse' flag.
-    for (uint8_t j = 0; j<8; j++)
+    cols[i] = pgm_read_byte(&logoArray[i]);
+    if (reverse) cols[i] ^= 0xff;
+  }
+  lcdDrawColumns(x, y, cols, 10, 8);
+  lcdDrawColumns(x, y+8, &cols[10], 10, 8);
+}
+
+// Draw n columns of up to 8 pixels each, with the upper left corner at (x, y).
+//  This is the format the font, the logo and the sprites are all stored in:
+//  one byte per column, bit 0 at the top, and a set bit means ON. Only the top
+//  'rows' bits of each column get drawn; the pixels under the rest are left
+//  alone. n can be up to 16. Pixels that would land outside the clip
+//  rectangle are dropped.
+void lcdDrawColumns(uint8_t x, uint8_t y, const uint8_t *cols, uint8_t n,
+                    uint8_t rows)
+{
+  if ((x > clipX1) || (y > clipY1)) return;
+  // Chop columns off the left and right...
+  if (x < clipX0)
+  {
+    uint8_t skip = clipX0 - x;
+    if (skip >= n) return;
+    cols += skip;
+    n -= skip;
+    x = clipX0;
+  }
+  if (n > (clipX1 - x + 1)) n = clipX1 - x + 1;
+  // ...and rows off the top and bottom. Rows above 'first' are left alone.
+  uint8_t first = 0;
+  if (y < clipY0)
+  {
+    if ((clipY0 - y) >= rows) return;
+    first = clipY0 - y;
+  }
+  if (rows > (clipY1 - y + 1)) rows = clipY1 - y + 1;
+  if (lcdDriver.layout == LAYOUT_COLUMNS)
+  {
+    // These columns are already the shape of a ks0108b page byte. If the
+    //  block sits on a page boundary, they go straight out.
+    uint8_t shift = y%8;
+    uint8_t mask = (0xff>>(8-rows)) & (0xff<<first);
+    if ((shift == 0) && (mask == 0xff))
     {
-      if (reverse == 0)
-      {
-        if (colTemp&0x01) lcdDrawPixel(x+i,y+j,ON);
-        else lcdDrawPixel(x+i,y+j,OFF);
-      }
-      else
+      lcdDriver.writeRun(x, y, n, cols);
+      return;
+    }
+    // Otherwise, each column covers part of a page, or straddles two; the
+    //  top of it is the bottom of one page, and the bottom is the top of the
+    //  next. Merge each part in with what's already there. lcdWriteMasked()
+    //  doesn't bother with a page if the mask doesn't touch it, which also
+    //  keeps us off the page past the bottom of the screen.
+    for (uint8_t i = 0; i<n; i++)
+    {
+      lcdWriteMasked(x+i, y, cols[i]<<shift, mask<<shift);
+      if (shift) lcdWriteMasked(x+i, y+8, cols[i]>>(8-shift),
+                                mask>>(8-shift));
+    }
+  }
+  else
+  {
+    // The t6963 stores rows, not columns, so we turn the block on its side
+    //  one row at a time and send each row out as a single burst.
+    for (uint8_t j = first; j<rows; j++)
+    {
+      uint8_t rowBits[2] = {0, 0};
+      for (uint8_t i = 0; i<n; i++)
       {
-        if (colTemp&0x01) lcdDrawPixel(x+i,y+j,OFF);
-        else lcdDrawPixel(x+i,y+j,ON);
+        if ((cols[i]>>j)&0x01) rowBits[i>>3] |= (0x80>>(i&0x07));
       }
-      // By right shifting, we keep the LSb the bit we're interested in.
-      //  That way, we only need to mask it with 0x01 and get a zero/nonzero
-      //  reading on it.
-      colTemp = colTemp>>1;
+      lcdDriver.writeRun(x, y+j, n, rowBits);
     }
-  }  
-  y+=8;  // Increment y, since we're drawing the lower half of the logo. Then
-         //  we do more or less exactly the same thing.
-  for (uint8_t i = 10; i<20; i++)
+  }
+}
+
+// A blit is a bitmap w pixels wide and h tall, in the same column format
+//  lcdDrawColumns() takes: the top 8 rows, w column bytes left to right, then
+//  the next 8 rows, and so on, with the bottom band only partly used if h
+//  isn't a multiple of 8. That's exactly how the ks0108b lays out its memory,
+//  so a full screen image goes out with the page auto-increment doing most of
+//  the work; the t6963 gets it turned on its side 16 columns at a time.
+//  Images can be bigger than our serial buffer, so they come in a piece at a
+//  time through lcdBlitWrite(); this is where we are in the current one.
+static uint8_t  blitX;
+static uint8_t  blitW;
+static uint8_t  blitCol;    // Next column to draw, within the current band.
+static uint16_t blitY;      // Top of the current band. This can run off the
+                            //  bottom of the screen, so it's 16 bits.
+static uint8_t  blitRows;   // Rows still to come, current band included.
+
+// Set up for a new blit. Returns the number of bytes of image data to expect.
+uint16_t lcdBlitBegin(uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+{
+  blitX = x;
+  blitY = y;
+  blitW = w;
+  blitRows = h;
+  blitCol = 0;
+  if ((w == 0) || (h == 0)) return 0;
+  return (uint16_t)w * ((h+7)/8);
+}
+
+// Read n columns of 8 pixels (n up to 16) off the glass at (x, y), in the same
+//  format lcdDrawColumns() takes. The drivers' readBlock functions do
+//  something like this for the sprites, but only 8 at a time, and they're
+//  not quite right when the block is lined up with a page or a byte.
+static void lcdReadColumns(uint8_t x, uint8_t y, uint8_t *cols, uint8_t n)
+{
+  uint8_t flip = reverse ? 0xff : 0x00;
+  if (lcdDriver.layout == LAYOUT_COLUMNS)
   {
-    uint8_t colTemp = pgm_read_byte(&logoArray[i]);
+    uint8_t shift = y%8;
+    uint8_t below[16];  // The next page down, if the block straddles two...
+    uint8_t straddle = shift && ((y - shift + 8) < yDim); // ...and it's there.
+    lcdDriver.readBytes(x, y, cols, n);
+    if (straddle) lcdDriver.readBytes(x, y+8, below, n);
+    for (uint8_t i = 0; i<n; i++)
+    {
+      cols[i] >>= shift;
+      if (straddle) cols[i] |= below[i]<<(8-shift);
+      cols[i] ^= flip;
+    }
+  }
+  else
+  {
+    for (uint8_t i = 0; i<n; i++) cols[i] = 0;
     for (uint8_t j = 0; j<8; j++)
     {
-      if (reverse == 0)
+      if ((y+j) >= yDim) break;
+      // 16 pixels, starting anywhere in a byte, fit in three bytes.
+      uint8_t rowBytes[3];
+      lcdDriver.readBytes(x, y+j, rowBytes, 3);
+      for (uint8_t i = 0; i<n; i++)
       {
-        if (colTemp&0x01) lcdDrawPixel(x+i-10,y+j,ON);
-        else lcdDrawPixel(x+i-10,y+j,OFF);
+        uint8_t bit = (x%8) + i;
+        if ((rowBytes[bit>>3] ^ flip) & (0x80>>(bit&0x07))) cols[i] |= 1<<j;
       }
+    }
+  }
+}
+
+// Draw the next n bytes of the image. n can be up to 16, and shouldn't run
+//  past the end of the image. With BLIT_XOR, the data is a difference from
+//  what's already on the screen, and 0 means "leave it alone"; since most of
+//  the screen usually doesn't change, we don't even read back the parts that
+//  come through as all zeroes.
+void lcdBlitWrite(const uint8_t *data, uint8_t n, uint8_t op)
+{
+  uint8_t cols[16];
+  while (n)
+  {
+    uint8_t chunk = blitW - blitCol;
+    if (chunk > n) chunk = n;
+    uint8_t rows = (blitRows < 8) ? blitRows : 8;
+    uint16_t x = blitX + blitCol;
+    if ((x < xDim) && (blitY < yDim))
+    {
+      if (op == BLIT_COPY) lcdDrawColumns(x, blitY, data, chunk, rows);
       else
       {
-        if (colTemp&0x01) lcdDrawPixel(x+i-10,y+j,OFF);
-        else lcdDrawPixel(x+i-10,y+j,ON);
+        uint8_t changed = 0;
+        for (uint8_t i = 0; i<chunk; i++) changed |= data[i];
+        if (changed)
+        {
+          lcdReadColumns(x, blitY, cols, chunk);
+          for (uint8_t i = 0; i<chunk; i++) cols[i] ^= data[i];
+          lcdDrawColumns(x, blitY, cols, chunk, rows);
+        }
       }
-      colTemp = colTemp>>1;
+    }
+    data += chunk;
+    n -= chunk;
+    blitCol += chunk;
+    if (blitCol == blitW)   // End of a band; on to the next one down.
+    {
+      blitCol = 0;
+      blitY += 8;
+      blitRows -= rows;
     }
   }
-
 }
 
 // lcdDrawPixel() is the generic front end to the display-specific drawPixel
 //  commands. We gate the draw to save time- no point in drawing a pixel that
-//  is outside the display area, which can happen in the case of large
-//  circles or lines or boxes.
+//  is outside the display area (or the clip rectangle). It goes through the
+//  same byte-at-a-time path as lines and circles, so it lands in the right
+//  order with respect to them.
 void lcdDrawPixel(uint8_t x, uint8_t y, PIX_VAL pixel)
 {
-	if (display == SMALL)
-	{
-		if (x<xDim && y<yDim) ks0108bDrawPixel(x, y, pixel);
-	}
-  else if (display == LARGE)
-  {
-    if (x<xDim && y<yDim) t6963DrawPixel(x, y, pixel);
-  }
+  if ((x < clipX0) || (x > clipX1) || (y < clipY0) || (y > clipY1)) return;
+  lcdCombine(x, y, pixel);
+  lcdCombineFlush();
+}
+
+// Anything drawn into the ks0108b shadow framebuffer only lands on the glass
+//  when this gets called. The main loop does it whenever it runs out of
+//  serial data to chew on; anything that wants the user to *see* a result
+//  right now (the demo, for instance) should call it, too.
+void lcdFlush(void)
+{
+  lcdCombineFlush();
+  if (lcdDriver.flush) lcdDriver.flush();
 }
 
 // Front-end for the display specific readBlock functions. This gets used in
@@ -616,6 +1032,5 @@ void lcdDrawPixel(uint8_t x, uint8_t y, PIX_VAL pixel)
 //  structure but it's easier for the ks0108b.
 void lcdGetDataBlock(uint8_t x, uint8_t y, uint8_t *buffer)
 {
-  if (display == SMALL) ks0108bReadBlock(x, y, buffer);
-  else                  t6963ReadBlock(x, y, buffer);
+  lcdDriver.readBlock(x, y, buffer);
 }
@@ -32,114 +32,156 @@ void		lcdDrawBox(uint8_t p1x, uint8_t p1y, uint8_t p2x, uint8_t p2y, PIX_VAL pix
 void		lcdDrawChar(char printMe);
 void    lcdDrawLogo(void);
 void    lcdEraseBlock(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+void    lcdFillRect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, PIX_VAL pixel);
 void    lcdGetDataBlock(uint8_t x, uint8_t y, uint8_t *buffer);
 void    lcdDrawSprite(uint8_t x, uint8_t y, uint8_t sprite, char angle, PIX_VAL pixel);
+void    lcdFlush(void);
+void    lcdSetClip(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+void    lcdSetTextLayer(uint8_t mode);
+void    lcdSetScroll(uint8_t on);
+void    lcdDrawColumns(uint8_t x, uint8_t y, const uint8_t *cols, uint8_t n,
+                       uint8_t rows);
+uint16_t lcdBlitBegin(uint8_t x, uint8_t y, uint8_t w, uint8_t h);
+void    lcdBlitWrite(const uint8_t *data, uint8_t n, uint8_t op);
+
+// What lcdBlitWrite() does with the image data.
+#define BLIT_COPY   0   // Draw it as is.
+#define BLIT_XOR    1   // Flip the pixels where the data has a 1.
 
 // Sprite maps for characters. Lifted from the original glcd code, which in turn
 //   lifted them from something called "Sinister 7". I don't know what that is.
 //   What I *do* know is that the original codes were upside-down, and I had
-//   to write a python script to reverse the bit order of these bitmaps.
-static char characterArray[475] PROGMEM = {
-	0x00,0x00,0x00,0x00,0x00,/*space*/
-	0x00,0x6f,0x6f,0x00,0x00,/*!*/
-	0x00,0x07,0x00,0x07,0x00,/*"*/
-	0x14,0x7f,0x14,0x7f,0x14,/*#*/
-	0x00,0x26,0x6b,0x2a,0x10,/*$*/
-	0x43,0x33,0x08,0x64,0x63,/*%*/
-	0x32,0x4d,0x49,0x36,0x50,/*&*/
-	0x00,0x00,0x07,0x00,0x00,/*'*/
-	0x00,0x1c,0x22,0x41,0x00,/*(*/
-	0x00,0x41,0x22,0x1c,0x00,/*)*/
-	0x11,0x0a,0x1f,0x0a,0x11,/***/
-	0x10,0x10,0x7c,0x10,0x10,/*+*/
-	0x00,0x00,0xa0,0x60,0x00,/*,*/
-	0x10,0x10,0x10,0x10,0x10,/*-*/
-	0x00,0x00,0x60,0x60,0x00,/*.*/
-	0x40,0x30,0x08,0x06,0x01,/*/*/
-	0x3e,0x51,0x49,0x45,0x3e,/*0*/
-	0x00,0x42,0x7f,0x40,0x00,/*1*/
-	0x42,0x61,0x51,0x49,0x46,/*2*/
-	0x22,0x41,0x49,0x49,0x36,/*3*/
-	0x08,0x0c,0x0a,0x7f,0x08,/*4*/
-	0x27,0x45,0x45,0x45,0x39,/*5*/
-	0x3c,0x4a,0x49,0x49,0x30,/*6*/
-	0x01,0x61,0x19,0x07,0x01,/*7*/
-	0x36,0x49,0x49,0x49,0x36,/*8*/
-	0x06,0x49,0x49,0x29,0x1e,/*9*/
-	0x00,0x00,0x6c,0x6c,0x00,/*:*/
-	0x00,0x00,0xac,0x6c,0x00,/*;*/
-	0x08,0x14,0x22,0x41,0x00,/*<*/
-	0x14,0x14,0x14,0x14,0x14,/*=*/
-	0x00,0x41,0x22,0x14,0x08,/*>*/
-	0x02,0x01,0x51,0x09,0x06,/*?*/
-	0x3e,0x41,0x5d,0x5d,0x46,/*@*/
-	0x7c,0x12,0x11,0x12,0x7c,/*A*/
-	0x7f,0x49,0x49,0x49,0x36,/*B*/
-	0x3e,0x41,0x41,0x41,0x22,/*C*/
-	0x7f,0x41,0x41,0x41,0x3e,/*D*/
-	0x7f,0x49,0x49,0x49,0x41,/*E*/
-	0x7f,0x09,0x09,0x09,0x01,/*F*/
-	0x3e,0x41,0x41,0x51,0x72,/*G*/
-	0x7f,0x08,0x08,0x08,0x7f,/*H*/
-	0x41,0x41,0x7f,0x41,0x41,/*I*/
-	0x21,0x41,0x3f,0x01,0x01,/*J*/
-	0x7f,0x08,0x14,0x22,0x41,/*K*/
-	0x7f,0x40,0x40,0x40,0x40,/*L*/
-	0x7f,0x02,0x04,0x02,0x7f,/*M*/
-	0x7f,0x06,0x08,0x30,0x7f,/*N*/
-	0x3e,0x41,0x41,0x41,0x3e,/*O*/
-	0x7f,0x09,0x09,0x09,0x06,/*P*/
-	0x3e,0x41,0x41,0x61,0x7e,/*Q*/
-	0x7f,0x09,0x19,0x29,0x46,/*R*/
-	0x26,0x49,0x49,0x49,0x32,/*S*/
-	0x01,0x01,0x7f,0x01,0x01,/*T*/
-	0x3f,0x40,0x40,0x40,0x3f,/*U*/
-	0x1f,0x20,0x40,0x20,0x1f,/*V*/
-	0x3f,0x40,0x30,0x40,0x3f,/*W*/
-	0x63,0x14,0x08,0x14,0x63,/*X*/
-	0x03,0x04,0x78,0x04,0x03,/*Y*/
-	0x61,0x51,0x49,0x45,0x43,/*Z*/
-	0x00,0x00,0x7f,0x41,0x00,/*[*/
-	0x00,0x00,0x00,0x00,0x00,/*this should be / */
-	0x01,0x06,0x08,0x30,0x40,/*]*/
-	0x04,0x02,0x01,0x02,0x04,/*^*/
-	0x80,0x80,0x80,0x80,0x80,/*_*/
-	0x01,0x02,0x04,0x00,0x00,/*`*/
-	0x20,0x54,0x54,0x54,0x78,/*a*/
-	0x7f,0x48,0x44,0x44,0x38,/*b*/
-	0x38,0x44,0x44,0x44,0x28,/*c*/
-	0x38,0x44,0x44,0x48,0x7f,/*d*/
-	0x38,0x54,0x54,0x54,0x18,/*e*/
-	0x08,0x7e,0x09,0x01,0x02,/*f*/
-	0x18,0xa4,0xa4,0xa4,0x78,/*g*/
-	0x7f,0x08,0x08,0x08,0x70,/*h*/
-	0x00,0x48,0x7a,0x40,0x00,/*i*/
-	0x40,0x80,0x80,0x88,0x7a,/*j*/
-	0x7f,0x10,0x10,0x28,0x44,/*k*/
-	0x00,0x41,0x7f,0x40,0x00,/*l*/
-	0x7c,0x04,0x38,0x04,0x78,/*m*/
-	0x7c,0x04,0x04,0x04,0x78,/*n*/
-	0x38,0x44,0x44,0x44,0x38,/*o*/
-	0xfc,0x24,0x24,0x24,0x18,/*p*/
-	0x18,0x24,0x24,0xfc,0x80,/*q*/
-	0x7c,0x08,0x04,0x04,0x08,/*r*/
-	0x48,0x54,0x54,0x54,0x20,/*s*/
-	0x00,0x08,0x3c,0x48,0x20,/*t*/
-	0x3c,0x40,0x40,0x40,0x7c,/*u*/
-	0x0c,0x30,0x40,0x30,0x0c,/*v*/
-	0x1c,0x60,0x18,0x60,0x1c,/*w*/
-	0x44,0x28,0x10,0x28,0x44,/*x*/
-	0x1c,0xa0,0xa0,0xa0,0x7c,/*y*/
-	0x44,0x64,0x54,0x4c,0x44,/*z*/
-	0x00,0x08,0x36,0x41,0x41,/*{*/
-	0x20,0x40,0xff,0x40,0x20,/*arrow*/
-	0x41,0x41,0x36,0x08,0x00,/*}*/
-	0x10,0x08,0x18,0x10,0x08/*~*/
-	};
+//   to write a python script to reverse the bit order of these bitmaps. Each
+//   glyph is five column bytes; FONT_GLYPH gets defined below to lay those
+//   out however a particular table needs them.
+#define FONT_GLYPHS \
+	FONT_GLYPH(0x00,0x00,0x00,0x00,0x00) /*space*/ \
+	FONT_GLYPH(0x00,0x6f,0x6f,0x00,0x00) /*!*/ \
+	FONT_GLYPH(0x00,0x07,0x00,0x07,0x00) /*"*/ \
+	FONT_GLYPH(0x14,0x7f,0x14,0x7f,0x14) /*#*/ \
+	FONT_GLYPH(0x00,0x26,0x6b,0x2a,0x10) /*$*/ \
+	FONT_GLYPH(0x43,0x33,0x08,0x64,0x63) /*%*/ \
+	FONT_GLYPH(0x32,0x4d,0x49,0x36,0x50) /*&*/ \
+	FONT_GLYPH(0x00,0x00,0x07,0x00,0x00) /*'*/ \
+	FONT_GLYPH(0x00,0x1c,0x22,0x41,0x00) /*(*/ \
+	FONT_GLYPH(0x00,0x41,0x22,0x1c,0x00) /*)*/ \
+	FONT_GLYPH(0x11,0x0a,0x1f,0x0a,0x11) /***/ \
+	FONT_GLYPH(0x10,0x10,0x7c,0x10,0x10) /*+*/ \
+	FONT_GLYPH(0x00,0x00,0xa0,0x60,0x00) /*,*/ \
+	FONT_GLYPH(0x10,0x10,0x10,0x10,0x10) /*-*/ \
+	FONT_GLYPH(0x00,0x00,0x60,0x60,0x00) /*.*/ \
+	FONT_GLYPH(0x40,0x30,0x08,0x06,0x01) /*/*/ \
+	FONT_GLYPH(0x3e,0x51,0x49,0x45,0x3e) /*0*/ \
+	FONT_GLYPH(0x00,0x42,0x7f,0x40,0x00) /*1*/ \
+	FONT_GLYPH(0x42,0x61,0x51,0x49,0x46) /*2*/ \
+	FONT_GLYPH(0x22,0x41,0x49,0x49,0x36) /*3*/ \
+	FONT_GLYPH(0x08,0x0c,0x0a,0x7f,0x08) /*4*/ \
+	FONT_GLYPH(0x27,0x45,0x45,0x45,0x39) /*5*/ \
+	FONT_GLYPH(0x3c,0x4a,0x49,0x49,0x30) /*6*/ \
+	FONT_GLYPH(0x01,0x61,0x19,0x07,0x01) /*7*/ \
+	FONT_GLYPH(0x36,0x49,0x49,0x49,0x36) /*8*/ \
+	FONT_GLYPH(0x06,0x49,0x49,0x29,0x1e) /*9*/ \
+	FONT_GLYPH(0x00,0x00,0x6c,0x6c,0x00) /*:*/ \
+	FONT_GLYPH(0x00,0x00,0xac,0x6c,0x00) /*;*/ \
+	FONT_GLYPH(0x08,0x14,0x22,0x41,0x00) /*<*/ \
+	FONT_GLYPH(0x14,0x14,0x14,0x14,0x14) /*=*/ \
+	FONT_GLYPH(0x00,0x41,0x22,0x14,0x08) /*>*/ \
+	FONT_GLYPH(0x02,0x01,0x51,0x09,0x06) /*?*/ \
+	FONT_GLYPH(0x3e,0x41,0x5d,0x5d,0x46) /*@*/ \
+	FONT_GLYPH(0x7c,0x12,0x11,0x12,0x7c) /*A*/ \
+	FONT_GLYPH(0x7f,0x49,0x49,0x49,0x36) /*B*/ \
+	FONT_GLYPH(0x3e,0x41,0x41,0x41,0x22) /*C*/ \
+	FONT_GLYPH(0x7f,0x41,0x41,0x41,0x3e) /*D*/ \
+	FONT_GLYPH(0x7f,0x49,0x49,0x49,0x41) /*E*/ \
+	FONT_GLYPH(0x7f,0x09,0x09,0x09,0x01) /*F*/ \
+	FONT_GLYPH(0x3e,0x41,0x41,0x51,0x72) /*G*/ \
+	FONT_GLYPH(0x7f,0x08,0x08,0x08,0x7f) /*H*/ \
+	FONT_GLYPH(0x41,0x41,0x7f,0x41,0x41) /*I*/ \
+	FONT_GLYPH(0x21,0x41,0x3f,0x01,0x01) /*J*/ \
+	FONT_GLYPH(0x7f,0x08,0x14,0x22,0x41) /*K*/ \
+	FONT_GLYPH(0x7f,0x40,0x40,0x40,0x40) /*L*/ \
+	FONT_GLYPH(0x7f,0x02,0x04,0x02,0x7f) /*M*/ \
+	FONT_GLYPH(0x7f,0x06,0x08,0x30,0x7f) /*N*/ \
+	FONT_GLYPH(0x3e,0x41,0x41,0x41,0x3e) /*O*/ \
+	FONT_GLYPH(0x7f,0x09,0x09,0x09,0x06) /*P*/ \
+	FONT_GLYPH(0x3e,0x41,0x41,0x61,0x7e) /*Q*/ \
+	FONT_GLYPH(0x7f,0x09,0x19,0x29,0x46) /*R*/ \
+	FONT_GLYPH(0x26,0x49,0x49,0x49,0x32) /*S*/ \
+	FONT_GLYPH(0x01,0x01,0x7f,0x01,0x01) /*T*/ \
+	FONT_GLYPH(0x3f,0x40,0x40,0x40,0x3f) /*U*/ \
+	FONT_GLYPH(0x1f,0x20,0x40,0x20,0x1f) /*V*/ \
+	FONT_GLYPH(0x3f,0x40,0x30,0x40,0x3f) /*W*/ \
+	FONT_GLYPH(0x63,0x14,0x08,0x14,0x63) /*X*/ \
+	FONT_GLYPH(0x03,0x04,0x78,0x04,0x03) /*Y*/ \
+	FONT_GLYPH(0x61,0x51,0x49,0x45,0x43) /*Z*/ \
+	FONT_GLYPH(0x00,0x00,0x7f,0x41,0x00) /*[*/ \
+	FONT_GLYPH(0x00,0x00,0x00,0x00,0x00) /*this should be / */ \
+	FONT_GLYPH(0x01,0x06,0x08,0x30,0x40) /*]*/ \
+	FONT_GLYPH(0x04,0x02,0x01,0x02,0x04) /*^*/ \
+	FONT_GLYPH(0x80,0x80,0x80,0x80,0x80) /*_*/ \
+	FONT_GLYPH(0x01,0x02,0x04,0x00,0x00) /*`*/ \
+	FONT_GLYPH(0x20,0x54,0x54,0x54,0x78) /*a*/ \
+	FONT_GLYPH(0x7f,0x48,0x44,0x44,0x38) /*b*/ \
+	FONT_GLYPH(0x38,0x44,0x44,0x44,0x28) /*c*/ \
+	FONT_GLYPH(0x38,0x44,0x44,0x48,0x7f) /*d*/ \
+	FONT_GLYPH(0x38,0x54,0x54,0x54,0x18) /*e*/ \
+	FONT_GLYPH(0x08,0x7e,0x09,0x01,0x02) /*f*/ \
+	FONT_GLYPH(0x18,0xa4,0xa4,0xa4,0x78) /*g*/ \
+	FONT_GLYPH(0x7f,0x08,0x08,0x08,0x70) /*h*/ \
+	FONT_GLYPH(0x00,0x48,0x7a,0x40,0x00) /*i*/ \
+	FONT_GLYPH(0x40,0x80,0x80,0x88,0x7a) /*j*/ \
+	FONT_GLYPH(0x7f,0x10,0x10,0x28,0x44) /*k*/ \
+	FONT_GLYPH(0x00,0x41,0x7f,0x40,0x00) /*l*/ \
+	FONT_GLYPH(0x7c,0x04,0x38,0x04,0x78) /*m*/ \
+	FONT_GLYPH(0x7c,0x04,0x04,0x04,0x78) /*n*/ \
+	FONT_GLYPH(0x38,0x44,0x44,0x44,0x38) /*o*/ \
+	FONT_GLYPH(0xfc,0x24,0x24,0x24,0x18) /*p*/ \
+	FONT_GLYPH(0x18,0x24,0x24,0xfc,0x80) /*q*/ \
+	FONT_GLYPH(0x7c,0x08,0x04,0x04,0x08) /*r*/ \
+	FONT_GLYPH(0x48,0x54,0x54,0x54,0x20) /*s*/ \
+	FONT_GLYPH(0x00,0x08,0x3c,0x48,0x20) /*t*/ \
+	FONT_GLYPH(0x3c,0x40,0x40,0x40,0x7c) /*u*/ \
+	FONT_GLYPH(0x0c,0x30,0x40,0x30,0x0c) /*v*/ \
+	FONT_GLYPH(0x1c,0x60,0x18,0x60,0x1c) /*w*/ \
+	FONT_GLYPH(0x44,0x28,0x10,0x28,0x44) /*x*/ \
+	FONT_GLYPH(0x1c,0xa0,0xa0,0xa0,0x7c) /*y*/ \
+	FONT_GLYPH(0x44,0x64,0x54,0x4c,0x44) /*z*/ \
+	FONT_GLYPH(0x00,0x08,0x36,0x41,0x41) /*{*/ \
+	FONT_GLYPH(0x20,0x40,0xff,0x40,0x20) /*arrow*/ \
+	FONT_GLYPH(0x41,0x41,0x36,0x08,0x00) /*}*/ \
+	FONT_GLYPH(0x10,0x08,0x18,0x10,0x08) /*~*/
+
+// The tables from here down live in the header, so every file that includes
+//  it gets its own copy. The compiler drops the copies a file never touches;
+//  they're marked unused so -Wall doesn't complain about each one.
+
+// The font, as the ks0108b likes it: five column bytes per glyph, bit 0 at
+//  the top.
+#define FONT_GLYPH(a,b,c,d,e) a,b,c,d,e,
+static char characterArray[475] PROGMEM __attribute__((unused)) = {
+  FONT_GLYPHS
+  };
+#undef FONT_GLYPH
+
+// The same font turned on its side, as the t6963 likes it: eight row bytes
+//  per glyph, top row first, bit 7 at the left. The preprocessor does the
+//  rotating for us, so the two copies can't drift apart. The sixth column of
+//  each row is the blank space between characters.
+#define FONT_ROW(r,a,b,c,d,e) ((((a)>>(r))&1)<<7 | (((b)>>(r))&1)<<6 | \
+                               (((c)>>(r))&1)<<5 | (((d)>>(r))&1)<<4 | \
+                               (((e)>>(r))&1)<<3)
+#define FONT_GLYPH(a,b,c,d,e) FONT_ROW(0,a,b,c,d,e), FONT_ROW(1,a,b,c,d,e), \
+                              FONT_ROW(2,a,b,c,d,e), FONT_ROW(3,a,b,c,d,e), \
+                              FONT_ROW(4,a,b,c,d,e), FONT_ROW(5,a,b,c,d,e), \
+                              FONT_ROW(6,a,b,c,d,e), FONT_ROW(7,a,b,c,d,e),
+static char characterRows[760] PROGMEM __attribute__((unused)) = {
+  FONT_GLYPHS
+  };
+#undef FONT_GLYPH
 
 // The SparkFun Logo rendered as a sprite 10 pixels wide and 16 pixels high.
 //  The first ten bytes are the top half, the second ten, the bottom half.
-static char logoArray[20] PROGMEM = {
+static char logoArray[20] PROGMEM __attribute__((unused)) = {
   0x80, 0xc0, 0x40, 0x0c, 0x3e,
   0xfe, 0xf2, 0xe0, 0xf0, 0xe0,
   0xff, 0x7f, 0x3f, 0x1f, 0x1f,
@@ -149,7 +191,7 @@ static char logoArray[20] PROGMEM = {
 
 // This is our block of sprites. It's an array of 128 8x8 sprites, mostly
 //  unused.
-static char spriteArray[1024] PROGMEM = {
+static char spriteArray[1024] PROGMEM __attribute__((unused)) = {
   0x00, 0x3f, 0x42, 0x91, 0x82, 0x91, 0x42, 0x3f, // Pac-man ghost
   0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, // four corners
   0x10, 0x20, 0x40, 0xff, 0xff, 0x40, 0x20, 0x10, // up arrow.
@@ -283,7 +325,7 @@ static char spriteArray[1024] PROGMEM = {
   
 // This is our block of sprite masks. The mask for the sprite should be a '1'
 //  anywhere we want the original background to show through.
-static char maskArray[1024] PROGMEM = {
+static char maskArray[1024] PROGMEM __attribute__((unused)) = {
   0xff, 0xc0, 0x81, 0x00, 0x01, 0x00, 0x81, 0xc0, // Pac-man ghost
   0x7e, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7e,
   0xef, 0xdf, 0xbf, 0x00, 0x00, 0xbf, 0xdf, 0xef, // up arrow
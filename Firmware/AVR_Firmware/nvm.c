@@ -59,7 +59,7 @@ uint8_t getReverse(void)
 // We don't want the user to set an invalid baud rate, so we don't allow it.
 void setBaudRate(char baudMode)
 {
-  if (baudMode >= '1' && baudMode <= '6')
+  if (baudMode >= '0' && baudMode <= '9')
     eeprom_write_byte((uint8_t *)BAUDRATE, baudMode);
 }
 
@@ -83,3 +83,40 @@ uint8_t getBacklightLevel(void)
 {
   return eeprom_read_byte((const uint8_t *)BACKLIGHT);
 }
+
+// Flow control is stored complemented, for the same reason reverse mode is:
+//  a factory-fresh 0xff should mean "off", since a host that isn't expecting
+//  XON/XOFF characters would be pretty surprised to get them.
+void setFlowControl(uint8_t mode)
+{
+  eeprom_write_byte((uint8_t *)FLOWCTRL, ~mode);
+}
+
+uint8_t getFlowControl(void)
+{
+  return 0x03 & ~eeprom_read_byte((const uint8_t *)FLOWCTRL);
+}
+
+// The ks0108b timing profile: how long to hold each strobe, and how long to
+//  wait around each read, in microseconds. 0 (or a factory-fresh 0xff) for
+//  either means "work it out"- calibrate at startup and poll the busy flag.
+//  Anything over 50us is just silly, so that's "work it out", too.
+void setKsTiming(uint8_t strobe, uint8_t read)
+{
+  eeprom_write_byte((uint8_t *)KS_STROBE, strobe);
+  eeprom_write_byte((uint8_t *)KS_READ, read);
+}
+
+uint8_t getKsStrobeDelay(void)
+{
+  uint8_t strobe = eeprom_read_byte((const uint8_t *)KS_STROBE);
+  if (strobe > 50) return 0;
+  return strobe;
+}
+
+uint8_t getKsReadDelay(void)
+{
+  uint8_t read = eeprom_read_byte((const uint8_t *)KS_READ);
+  if (read > 50) return 0;
+  return read;
+}
@@ -21,6 +21,9 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 #define REVERSE    0x01
 #define BAUDRATE   0x02
 #define BACKLIGHT  0x03
+#define FLOWCTRL   0x04
+#define KS_STROBE  0x05
+#define KS_READ    0x06
 
 void    toggleSplash(void);
 uint8_t getSplash(void);
@@ -30,5 +33,10 @@ void    setBaudRate(char baudMode);
 char    getBaudRate(void);
 void    setBacklightLevel(uint8_t newLevel);
 uint8_t getBacklightLevel(void);
+void    setFlowControl(uint8_t mode);
+uint8_t getFlowControl(void);
+void    setKsTiming(uint8_t strobe, uint8_t read);
+uint8_t getKsStrobeDelay(void);
+uint8_t getKsReadDelay(void);
 
 #endif
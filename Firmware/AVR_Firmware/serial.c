@@ -15,37 +15,160 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 
 
 #include <avr/io.h>
+#include <util/atomic.h>
 #include "serial.h"
 #include "glcdbp.h"
+#include "io_support.h"
 
 // These variables are defined in glcdbp.c, and are used for the input buffer
 //   from the serial port. We need to be able to access them here because we'll
 //   want to abstract popping from the buffer to a function.
 extern volatile uint8_t   rxRingBuffer[BUF_DEPTH];
-extern volatile uint16_t  rxRingHead;
-extern volatile uint16_t  rxRingTail;
-extern volatile uint8_t   bufferSize;
+extern volatile uint8_t   rxRingHead;
+extern volatile uint8_t   rxRingTail;
+extern uint8_t            flowControl;
+extern volatile uint8_t   rxThrottled;
+extern volatile uint8_t   txRingBuffer[TX_DEPTH];
+extern volatile uint8_t   txRingHead;
+extern volatile uint8_t   txRingTail;
+extern volatile uint8_t   txFlowChar;
 
-// Initialize the serial port hardware.
+// Initialize the serial port hardware. Anything still waiting to go out
+//  goes first, at the old rate; otherwise it'd go out garbled at the new one.
 void serialInit(uint16_t baudRate)
 {
+  serialTxFlush();
+
   // Set baud rate 
   UBRR0 = baudRate;
 
   // Enable receiver and transmitter 
   UCSR0A = (1<<U2X0);
   UCSR0B = (1<<RXCIE0)|(1<<RXEN0)|(1<<TXEN0);  //Enable Interrupts on receive
+  // The transmit interrupt turns itself off when there's nothing to send, so
+  //  it's safe to turn it on here; if the receive interrupt has squeezed an
+  //  XOFF in since the flush, this makes sure it still goes.
+  UCSR0B |= (1<<UDRIE0);
 
   UCSR0C = (1<<UCSZ00)|(1<<UCSZ01);
 }
 
-// A simple function that waits for the clear to send from the USART, then
-//  dumps out a data byte. All other serial puts are based on this.
+// Switch to the baud rate for one of the ASCII baud rate codes we use in the
+//  CTRL-g command and in EEPROM. Invalid codes are ignored.
+void serialSetBaud(char baudMode)
+{
+  switch(baudMode)
+  {
+    case '1':
+    serialInit(BR4800);
+    break;
+    case '2':
+    serialInit(BR9600);
+    break;
+    case '3':
+    serialInit(BR19200);
+    break;
+    case '4':
+    serialInit(BR38400);
+    break;
+    case '5':
+    serialInit(BR57600);
+    break;
+    case '6':
+    serialInit(BR115200);
+    break;
+    case '7':
+    serialInit(BR230400);
+    break;
+    case '8':
+    serialInit(BR250000);
+    break;
+    case '9':
+    serialInit(BR500000);
+    break;
+    case '0':
+    serialInit(BR1000000);
+    break;
+    default:
+    break;
+  }
+}
+
+// Queue a byte to go out, without waiting. The data register empty interrupt
+//  (in interrupts.c) sends it when the USART is ready for it. Returns 1 if
+//  the byte was queued, or 0 if the ring is full and it wasn't- in which case
+//  the caller can try again later, or give up on it.
+// This is the only place txRingHead gets written, and the byte goes in before
+//  the head moves past it, so the interrupt never sees a half-queued byte.
+uint8_t serialTxPut(uint8_t TXData)
+{
+  uint8_t head = txRingHead;
+  // As with the receive ring, one slot always stays empty.
+  if ((uint8_t)(head - txRingTail) == (uint8_t)TX_MASK) return 0;
+  txRingBuffer[head & TX_MASK] = TXData;
+  txRingHead = head + 1;
+  // The interrupt turns itself off when it runs out of bytes, so turn it
+  //  back on. If it fires between our read and write of UCSR0B and turns
+  //  itself off, we turn it right back on, and it just finds nothing to do.
+  UCSR0B |= (1<<UDRIE0);
+  return 1;
+}
+
+// How many bytes are still waiting to go out.
+uint8_t serialTxCount(void)
+{
+  return txRingHead - txRingTail;
+}
+
+// Give the USART the next byte to send. This is the body of the data
+//  register empty interrupt (see interrupts.c); XON and XOFF jump the queue
+//  (see serialThrottle()). Once there's nothing left to send, it turns the
+//  interrupt off, or it'd fire again as soon as it returned. serialTxPut()
+//  turns it back on.
+// This is the only place txRingTail gets written, and it only ever runs with
+//  interrupts off, so it can't trip over itself.
+void serialTxNext(void)
+{
+  uint8_t tail = txRingTail;
+  if (txFlowChar != 0)
+  {
+    UDR0 = txFlowChar;
+    txFlowChar = 0;
+  }
+  else if (tail != txRingHead)
+  {
+    UDR0 = txRingBuffer[tail & TX_MASK];
+    txRingTail = ++tail;
+  }
+  if (tail == txRingHead) UCSR0B &= ~(1<<UDRIE0);
+}
+
+// Wait a little for the transmit ring to drain. Usually the interrupt is
+//  doing the work, but if interrupts are off (we're in an interrupt handler,
+//  or they haven't been turned on yet) it can't, so we do its job for it
+//  whenever the USART is ready for another byte. Interrupts go off while we
+//  do, so we don't trip over the interrupt when they're on.
+static void serialTxWait(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (UCSR0A & (1<<UDRE0)) serialTxNext();
+  }
+}
+
+// Wait for everything in the transmit ring to go out.
+void serialTxFlush(void)
+{
+  while ((txRingHead != txRingTail) || (txFlowChar != 0)) serialTxWait();
+}
+
+// Queue a byte to go out, waiting for room if the ring is full. All other
+//  serial puts are based on this. Usually there's room, and this costs about
+//  as much as storing a byte; the wait is only for replies bigger than the
+//  ring.
 void putChar(uint8_t TXData)
 {
-  while ( !( UCSR0A & (1<<UDRE0)) );  // Wait for empty transmit buffer
-  UDR0 = TXData;    // Put data into buffer; uC automatically
-                    //  sends data once it's written.
+  while (serialTxPut(TXData) == 0) serialTxWait();
 }
 
 // I probably didn't need to write this, but I did. Converts an 8-bit number
@@ -99,21 +222,88 @@ void putLine(char *TXData)
   putChar('\r');
 }
 
-// Grab the top byte off the serial FIFO and return it, adjusting the pointers
-//  and size of the FIFO accordingly.
+// Send XON or XOFF. These can't wait their turn behind whatever's in the
+//  transmit ring, and XOFF gets sent from the receive interrupt, which has
+//  no business waiting for room there. So they get a slot of their own,
+//  which the transmit interrupt empties before it looks at the ring. If
+//  there's one in there that hasn't gone yet, the new one replaces it; only
+//  the latest one means anything to the host.
+static void serialFlowChar(uint8_t flowChar)
+{
+  txFlowChar = flowChar;
+  UCSR0B |= (1<<UDRIE0);
+}
+
+// Tell the host to stop sending; the buffer is getting full. This gets
+//  called from the receive interrupt.
+void serialThrottle(void)
+{
+  rxThrottled = 1;
+  if (flowControl & FLOW_RTS)     PORTB |= (1<<RTS);
+  if (flowControl & FLOW_XONXOFF) serialFlowChar(XOFF);
+}
+
+// How many bytes are waiting in the FIFO. The head and tail indices are
+//  free-running 8-bit counters, so the difference between them is the
+//  count, even after one of them has rolled over. Each is a single byte, so
+//  reading it can't get torn in half by the receive interrupt; at worst, we
+//  see one fewer byte than has actually arrived.
+uint8_t serialBufferCount(void)
+{
+  return rxRingHead - rxRingTail;
+}
+
+// Tell the host it can start sending again, if we'd told it to stop and
+//  we've since made enough room.
+static void serialUnthrottle(void)
+{
+  if ((rxThrottled == 0) || (serialBufferCount() > RX_LOW_WATER)) return;
+  rxThrottled = 0;
+  if (flowControl & FLOW_RTS)     PORTB &= ~(1<<RTS);
+  if (flowControl & FLOW_XONXOFF) serialFlowChar(XON);
+}
+
+// Grab the top byte off the serial FIFO and return it, adjusting the tail
+//  of the FIFO accordingly. The caller has to make sure there's something
+//  there first.
 char serialBufferPop(void)
 {
-  bufferSize--;
-  char retVal = rxRingBuffer[rxRingTail++];
-  if (rxRingTail == BUF_DEPTH) rxRingTail = 0;
+  uint8_t tail = rxRingTail;
+  char retVal = rxRingBuffer[tail & BUF_MASK];
+  rxRingTail = tail + 1;
+  serialUnthrottle();
   return retVal;
 }
 
+// Look at a byte in the FIFO without removing it. offset 0 is the byte that
+//  serialBufferPop() would return next. The caller has to make sure there
+//  are at least offset+1 bytes in the buffer.
+char serialBufferPeek(uint8_t offset)
+{
+  return rxRingBuffer[(uint8_t)(rxRingTail + offset) & BUF_MASK];
+}
+
+// Copy count bytes out of the FIFO, starting offset bytes in, without
+//  removing them. Same rules as serialBufferPeek().
+void serialBufferPeekBlock(uint8_t *dest, uint8_t offset, uint8_t count)
+{
+  uint8_t index = rxRingTail + offset;
+  while (count--) *(dest++) = rxRingBuffer[(index++) & BUF_MASK];
+}
+
+// Throw away the top count bytes of the FIFO, usually after having looked at
+//  them with serialBufferPeek().
+void serialBufferDrop(uint8_t count)
+{
+  rxRingTail += count;
+  serialUnthrottle();
+}
+
 // Clear the FIFO buffer. Note that this doesn't actually delete the info in
-//  the buffer, it just resets the size and the pointers.
+//  the buffer, it just catches the tail up to the head. We don't touch the
+//  head; that belongs to the receive interrupt.
 void clearBuffer(void)
 {
-  bufferSize = 0;
-  rxRingTail = 0;
-  rxRingHead = 0;
+  rxRingTail = rxRingHead;
+  serialUnthrottle();
 }
@@ -16,23 +16,46 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 
 // These are the values for the baud rate generator corresponding to these bit
 //  rates. For more information about bit error percentages and what these
-//  numbers mean, see the datasheet for the processor.
+//  numbers mean, see the datasheet for the processor. 115200 and 230400 are
+//  off by 2-3.5% at 16MHz; the three fastest rates divide evenly, so they're
+//  dead on.
 enum {
 	BR4800		= 416,
 	BR9600  	= 207,
 	BR19200		= 103,
 	BR38400		= 51,
 	BR57600		= 34,
-	BR115200	= 16
+	BR115200	= 16,
+	BR230400	= 8,
+	BR250000	= 7,
+	BR500000	= 3,
+	BR1000000	= 1
 	};
 
+// Flow control options; these are bits, so both can be on at once.
+#define FLOW_XONXOFF  0x01
+#define FLOW_RTS      0x02
+
+#define XON   0x11
+#define XOFF  0x13
+
 void serialInit(uint16_t baudRate);
+void serialSetBaud(char baudMode);
+uint8_t serialTxPut(uint8_t TXData);
+uint8_t serialTxCount(void);
+void serialTxNext(void);
+void serialTxFlush(void);
 void putChar(uint8_t TXData);
 void putHex(uint8_t TXData);
 void putDec(uint8_t TXData);
 void putBin(uint8_t TXData);
 void putLine(char *TXData);
+uint8_t serialBufferCount(void);
 char serialBufferPop(void);
+char serialBufferPeek(uint8_t offset);
+void serialBufferPeekBlock(uint8_t *dest, uint8_t offset, uint8_t count);
+void serialBufferDrop(uint8_t count);
 void clearBuffer(void);
+void serialThrottle(void);
 
 #endif
@@ -13,6 +13,7 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 ***************************************************************************/
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>		// F_CPU is defined in the makefile
 #include "glcdbp.h"
 #include "serial.h"
@@ -21,29 +22,31 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 
 extern volatile uint8_t reverse; // This is defined in glcdbp.c
 
-// Basic functionality: clearing the display. All we're *really* doing is 
-//  writing a one or zero to all the memory locations for the display.
-void t6963Clear(void)
+// Where the controller's address pointer is, as far as we know. Setting it
+//  costs two data bytes and a command, each with a status check, and most of
+//  the time the pointer is already where we want it- the auto modes and the
+//  0xC0 write leave it just past the last byte, which is often where the next
+//  write starts. 0xFFFF means we don't know.
+static uint16_t pointerCache = 0xFFFF;
+
+// Where the top of the screen is in display memory, for each layer. These
+//  start out at the beginning of each layer's memory and move down as we
+//  scroll; every address we work out starts from one of them.
+static uint16_t graphicHome = 0x0000;
+static uint16_t textHome = TEXT_HOME;
+
+// The address of the first byte of pixel row y.
+static uint16_t t6963RowAddress(uint8_t y)
 {
-  // Begin at the beginning.
-  t6963SetPointer(0,0);
-  // Then, clear out the whole enchilada. We *could* use the auto increment 
-  //  mode here to shorten this up a bit, but meh. That would save us the 
-  //  command write for each loop, and reduce the overall time by probably a 
-  //  few milliseconds.
-  for (uint16_t i = 0; i < 2560; i++)
-  {
-    if (reverse) t6963WriteData(0xff);
-    else         t6963WriteData(0x00);
-    t6963WriteCmd(0xc0);  // This is the "write-data-then-increment-pointer"
-                          //  command. Useful.
-  }
+  return graphicHome + (y * 20);
 }
 
-// Write a data byte to the controller.
-void t6963WriteData(uint8_t data)
+// The raw bus transactions. These are the strobes and nothing else; the
+//  public read/write functions below wrap them in a status check. We need
+//  them bare for the auto read/write modes, where the normal busy bits
+//  aren't valid and we have to watch STA2/STA3 instead.
+static void t6963PutData(uint8_t data)
 {
-  t6963BusyWait(); // Wait for the controller to be ready.
   setData(data);   // Set up the data onto the lines.
   PORTC &= ~(1<<CD); // This tells the controller that we are sending DATA, not
                      //  a command
@@ -58,10 +61,8 @@ void t6963WriteData(uint8_t data)
             (1<<RD));
 }
 
-// Read a data byte from the controller.
-uint8_t t6963ReadData(void)
-{  
-  t6963BusyWait();  // Wait for controller to be ready.
+static uint8_t t6963GetData(void)
+{
   uint8_t data;
   PORTC &= ~(1<<CD); // This is a DATA transaction.
   _delay_us(1);      // Hold time.
@@ -76,11 +77,8 @@ uint8_t t6963ReadData(void)
   return data;
 }
 
-// Write a command to the controller. Note that "reading" a command is
-//  nonsensical and no ReadCommand() function is provided.
-void t6963WriteCmd(uint8_t command)
-{  
-  t6963BusyWait();   // Wait for controller to be ready.
+static void t6963PutCmd(uint8_t command)
+{
   setData(command);  // Set up the data on the lines.
   _delay_us(1);      // Hold time.
   PORTC &= ~(1<<WR); // Tell the controller that we're WRITING.
@@ -93,6 +91,37 @@ void t6963WriteCmd(uint8_t command)
             (1<<RD));
 }
 
+// Basic functionality: clearing the display. All we're *really* doing is 
+//  writing a one or zero to all the memory locations for the display, which
+//  is exactly what auto write mode is for.
+void t6963Clear(void)
+{
+  if (reverse) t6963FillBurst(graphicHome, 0xff, 2560);
+  else         t6963FillBurst(graphicHome, 0x00, 2560);
+}
+
+// Write a data byte to the controller.
+void t6963WriteData(uint8_t data)
+{
+  t6963BusyWait(); // Wait for the controller to be ready.
+  t6963PutData(data);
+}
+
+// Read a data byte from the controller.
+uint8_t t6963ReadData(void)
+{  
+  t6963BusyWait();  // Wait for controller to be ready.
+  return t6963GetData();
+}
+
+// Write a command to the controller. Note that "reading" a command is
+//  nonsensical and no ReadCommand() function is provided.
+void t6963WriteCmd(uint8_t command)
+{  
+  t6963BusyWait();   // Wait for controller to be ready.
+  t6963PutCmd(command);
+}
+
 // Read the current chip status. Note that writing the status is not allowed.
 uint8_t t6963ReadStatus(void)
 {  
@@ -137,8 +166,14 @@ void t6963SetPointer(uint8_t x, uint8_t y)
   //  increase by one location. Using a 3-right-shift is a cheap way of doing
   //  divide by 8 in a processor without a divide operation. Maybe the
   //  compiler knows that, maybe not.
-  uint16_t pointerAddress = (y * 20) + (x>>3);
-  // Now that we have our address, we can write our data out.
+  t6963SetAddress(t6963RowAddress(y) + (x>>3));
+}
+
+// Set the pointer to a raw address in display memory.
+void t6963SetAddress(uint16_t pointerAddress)
+{
+  if (pointerAddress == pointerCache) return;  // Already there.
+  pointerCache = pointerAddress;
   // This is the low byte of the address
   t6963WriteData((uint8_t)pointerAddress);
   // This is the high byte of the address
@@ -146,8 +181,79 @@ void t6963SetPointer(uint8_t x, uint8_t y)
   t6963WriteCmd(0x24);  // This is the command for "set pointer address".
 }
 
+// While the controller is in one of the auto modes, STA0 and STA1 don't mean
+//  anything; instead, STA2 says it's ready for the next auto read and STA3
+//  for the next auto write. Those are the only checks we need per byte, which
+//  is what makes the auto modes so much quicker than data+command pairs.
+static void t6963AutoWait(uint8_t readyBit)
+{
+  while ((t6963ReadStatus() & readyBit) == 0x00);
+}
+
+// Write n bytes from src into display memory, starting at addr, using the
+//  Data Auto Write mode (0xB0). The controller bumps the pointer itself after
+//  each byte, and we finish with Auto Reset (0xB2) to go back to normal mode.
+void t6963WriteBurst(uint16_t addr, const uint8_t *src, uint16_t n)
+{
+  t6963SetAddress(addr);
+  pointerCache = addr + n;  // Where the pointer will be when we're done.
+  t6963WriteCmd(0xb0);
+  while (n--)
+  {
+    t6963AutoWait(STA3);
+    t6963PutData(*src++);
+  }
+  t6963AutoWait(STA3);
+  t6963PutCmd(0xb2);
+}
+
+// Same as t6963WriteBurst(), but every byte is the same value. Saves us
+//  needing a buffer to clear big swaths of the screen.
+void t6963FillBurst(uint16_t addr, uint8_t value, uint16_t n)
+{
+  t6963SetAddress(addr);
+  pointerCache = addr + n;
+  t6963WriteCmd(0xb0);
+  while (n--)
+  {
+    t6963AutoWait(STA3);
+    t6963PutData(value);
+  }
+  t6963AutoWait(STA3);
+  t6963PutCmd(0xb2);
+}
+
+// Read n bytes of display memory, starting at addr, into dst, using the Data
+//  Auto Read mode (0xB1). A single byte is cheaper as a plain Data Read
+//  (0xC5), which leaves the pointer on it, ready for writing back.
+void t6963ReadBurst(uint16_t addr, uint8_t *dst, uint16_t n)
+{
+  t6963SetAddress(addr);
+  if (n == 1)
+  {
+    t6963WriteCmd(0xc5);  // Read data, leave the pointer alone.
+    *dst = t6963ReadData();
+    return;
+  }
+  pointerCache = addr + n;
+  t6963WriteCmd(0xb1);
+  while (n--)
+  {
+    t6963AutoWait(STA2);
+    *dst++ = t6963GetData();
+  }
+  // Same as the write side: let the controller finish with the last byte
+  //  before we ask it to leave auto mode.
+  t6963AutoWait(STA2);
+  t6963PutCmd(0xb2);
+}
+
 void t6963DisplayInit(void)
 {
+  pointerCache = 0xFFFF;  // Who knows what the pointer's been up to?
+  graphicHome = 0x0000;
+  textHome = TEXT_HOME;
+
   // The first part of display initialization is to set the start location of
   //  the graphics in memory. We'll set it to 0x0000.
   t6963WriteData(0x00); // Write the low byte of the graphics home address.
@@ -162,17 +268,27 @@ void t6963DisplayInit(void)
   t6963WriteData(0x00); // Always zero.
   t6963WriteCmd(0x43);  // "Write graphics area" command.
   
+  // The text layer lives right after the graphics, and is set up the same
+  //  way: a home address and a line length. We always set it up, even though
+  //  it stays switched off until somebody asks for it (see t6963TextMode()).
+  t6963WriteData((uint8_t)TEXT_HOME);       // Low byte of text home.
+  t6963WriteData((uint8_t)(TEXT_HOME>>8));  // High byte of text home.
+  t6963WriteCmd(0x40);  // "Write text home address" command.
+  t6963WriteData(TEXT_COLS); // # characters per line (160 pixels/8 per char)
+  t6963WriteData(0x00); // Always zero.
+  t6963WriteCmd(0x41);  // "Write text area" command.
+  
   // Now we need to write the mode set command; most likely, this is not
   //  needed, because the defaults should work, but never trust the defaults.
-  //  Also, I *think* this only really affects the way text is rendered, and
-  //  since we're only doing graphics rendering, it probably doesn't matter.
+  //  This only affects the way text is combined with graphics, and until
+  //  the text layer gets turned on, it doesn't matter.
   //  Register takes the form
   //    1  0  0  0  CG  MD2  MD1  MD0
   //  CG -    0   = internal ROM character generation
   //          1   = RAM character generation
   //  MD2-0 - 000 = OR mode
   //          001 = XOR mode
-  //          010 = AND mode
+  //          011 = AND mode
   //          100 = TEXT ATTRIBUTE mode
   t6963WriteCmd(0x80);
   
@@ -186,6 +302,98 @@ void t6963DisplayInit(void)
   t6963WriteCmd(0x98);
 }
 
+// Turn the text layer on or off. mode is one of the TEXT_xxx values in
+//  t6963.h; anything other than TEXT_OFF also picks how text is combined with
+//  whatever is on the graphics layer underneath it. Turning it on wipes the
+//  text layer, since its power-on contents are garbage.
+void t6963TextMode(uint8_t mode)
+{
+  if (mode == TEXT_OFF)
+  {
+    t6963WriteCmd(0x98);  // Graphics only.
+    return;
+  }
+  // OR and XOR are MD2-0 of 000 and 001; AND is 011.
+  if (mode == TEXT_AND) t6963WriteCmd(0x83);
+  else                  t6963WriteCmd(0x80 | (mode - 1));
+  t6963ClearText();
+  t6963WriteCmd(0x9c);    // Graphics AND text.
+}
+
+// Blank the whole text layer. Character code 0 is a space.
+void t6963ClearText(void)
+{
+  t6963FillBurst(textHome, 0x00, TEXT_COLS * TEXT_ROWS);
+}
+
+// Put a character into the text layer at character cell (col, row). The
+//  built-in character generator's codes are ASCII, offset so that a space is
+//  zero. This is one byte into display memory, versus 40-odd pixel commands
+//  to draw the same character into the graphics layer. The pointer moves on
+//  to the next cell afterwards, which is where the next character usually
+//  goes, so a line of text only sets the pointer once.
+void t6963WriteText(uint8_t col, uint8_t row, char printMe)
+{
+  t6963SetAddress(textHome + (row * TEXT_COLS) + col);
+  t6963WriteData(printMe - ' ');
+  t6963WriteCmd(0xc0);  // Write data, move the pointer up one.
+  pointerCache++;
+}
+
+// Set the home address of a layer: 0x40 for text, 0x42 for graphics. This
+//  is the address of whatever goes in the top left corner of the screen.
+static void t6963SetHome(uint8_t command, uint16_t home)
+{
+  t6963WriteData((uint8_t)home);
+  t6963WriteData((uint8_t)(home>>8));
+  t6963WriteCmd(command);
+}
+
+// Scroll one layer up by a line: 'line' bytes, out of a 'screen' bytes
+//  window that starts at 'home', somewhere in 'size' bytes of memory
+//  starting at 'start'. Usually that's just blanking the line below the
+//  window (with 'fill') and moving the home address down to take it in.
+//  When we run out of room, the part of the window that's staying gets
+//  copied back to the start first, 20 bytes (a row of either layer) at a
+//  time; the copy goes somewhere that isn't on the screen, so nobody sees it
+//  happen. Returns the new home address.
+static uint16_t t6963ScrollLayer(uint8_t command, uint16_t home,
+                                 uint16_t start, uint16_t size,
+                                 uint16_t screen, uint16_t line, uint8_t fill)
+{
+  home += line;
+  if (home + screen > start + size)
+  {
+    uint8_t buffer[20];
+    for (uint16_t i = 0; i < screen - line; i += 20)
+    {
+      t6963ReadBurst(home + i, buffer, 20);
+      t6963WriteBurst(start + i, buffer, 20);
+    }
+    home = start;
+  }
+  t6963FillBurst(home + screen - line, fill, line);
+  t6963SetHome(command, home);
+  return home;
+}
+
+// Move the graphics up 8 pixel rows, one line of text.
+void t6963Scroll(void)
+{
+  uint8_t fill = 0x00;
+  if (reverse) fill = 0xff;
+  graphicHome = t6963ScrollLayer(0x42, graphicHome, 0x0000,
+                                 GRAPHIC_ROWS * 20, 128 * 20, 8 * 20, fill);
+}
+
+// Move the text layer up one row of cells. Character code 0 is a space.
+void t6963ScrollText(void)
+{
+  textHome = t6963ScrollLayer(0x40, textHome, TEXT_HOME,
+                              TEXT_RING * TEXT_COLS, TEXT_ROWS * TEXT_COLS,
+                              TEXT_COLS, 0x00);
+}
+
 // In addition to bytewise read/write of data, the t6963 can do a bitwise
 //  set/reset of pixels natively. To do this, we use this command:
 //    1  1  1  1  S/R  B2  B1  B0
@@ -231,6 +439,95 @@ void t6963DrawPixel(uint8_t x, uint8_t y, PIX_VAL pixel)
   }
 }
 
+// Set (to ON) the bits of the byte holding (x, y) that are in 'set', and
+//  clear (to OFF) the ones in 'clear'; bit 7 is the leftmost pixel, as usual.
+//  The bit set/reset command doesn't move the address pointer, so however
+//  many bits we change, we only point at the byte once, and we never have to
+//  read it.
+void t6963WriteBits(uint8_t x, uint8_t y, uint8_t set, uint8_t clear)
+{
+  uint8_t on = PIX_LT;
+  uint8_t off = PIX_DK;
+  if (reverse)
+  {
+    on = PIX_DK;
+    off = PIX_LT;
+  }
+  t6963SetPointer(x, y);
+  for (uint8_t bit = 0; bit < 8; bit++)
+  {
+    if (set & (1<<bit))   t6963BitSR(bit, on);
+    if (clear & (1<<bit)) t6963BitSR(bit, off);
+  }
+}
+
+// Write a horizontal run of width pixels, starting at (x, y), taking the
+//  pixel values from bits. bits is packed the same way the display memory is:
+//  bit 7 of bits[0] is the leftmost pixel. If bits is null, every pixel is
+//  set to fill instead. The run doesn't need to start or end on a byte
+//  boundary; any partial bytes at either end are read back and merged so the
+//  pixels on either side of the run are left alone. The whole thing goes out
+//  in one auto-write burst.
+static void t6963MergeRow(uint8_t x, uint8_t y, uint8_t width,
+                          const uint8_t *bits, PIX_VAL fill)
+{
+  uint8_t rowBuffer[21];  // A full-width row, plus one for misalignment.
+  uint8_t shift = x%8;
+  uint8_t first = x>>3;
+  uint8_t count = ((uint16_t)x + width - 1)/8 - first + 1;
+  uint8_t srcBytes = (width+7)>>3;
+  uint8_t headMask = 0xff>>shift;
+  uint8_t tailMask = 0xff<<(7 - (((uint16_t)x + width - 1)%8));
+  uint16_t addr = t6963RowAddress(y) + first;
+  uint8_t fillByte = 0x00;
+  if (fill == ON) fillByte = 0xff;
+
+  if (count == 1) headMask &= tailMask;
+  // Fetch the bytes we're only going to partly overwrite. The tail goes
+  //  first, so the pointer is left on the head, where the write starts.
+  if ((count > 1) && (tailMask != 0xff))
+    t6963ReadBurst(addr + count - 1, &rowBuffer[count - 1], 1);
+  if (headMask != 0xff) t6963ReadBurst(addr, &rowBuffer[0], 1);
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    uint8_t data = fillByte;
+    if (bits)
+    {
+      data = 0;
+      if (i < srcBytes) data = bits[i]>>shift;
+      if ((i > 0) && (shift != 0)) data |= bits[i-1]<<(8-shift);
+    }
+    // A set bit is a lit pixel; in reverse mode "on" is dark, instead.
+    if (reverse) data ^= 0xff;
+    uint8_t mask = 0xff;
+    if (i == 0) mask = headMask;
+    if (i == count - 1) mask &= tailMask;
+    rowBuffer[i] = (rowBuffer[i] & ~mask) | (data & mask);
+  }
+  t6963WriteBurst(addr, rowBuffer, count);
+}
+
+void t6963WriteRow(uint8_t x, uint8_t y, uint8_t width, const uint8_t *bits)
+{
+  if (width == 0) return;
+  t6963MergeRow(x, y, width, bits, OFF);
+}
+
+void t6963FillRow(uint8_t x, uint8_t y, uint8_t width, PIX_VAL pixel)
+{
+  if (width == 0) return;
+  t6963MergeRow(x, y, width, 0, pixel);
+}
+
+// Read n bytes of the row at y, starting with the one holding pixel x, in one
+//  auto-read burst. Same format as display memory: bit 7 is the leftmost
+//  pixel, and reverse mode isn't undone.
+void t6963ReadBytes(uint8_t x, uint8_t y, uint8_t *dst, uint8_t n)
+{
+  t6963ReadBurst(t6963RowAddress(y) + (x>>3), dst, n);
+}
+
 // Read an 8x8 block of pixels. Pixels in the t6963 world are in 8-bit blocks,
 //  so we may need to read up to 16 bytes of data and do some shifting around
 //  to get the data we want. The data that we return should be a buffer of
@@ -240,21 +537,17 @@ void t6963DrawPixel(uint8_t x, uint8_t y, PIX_VAL pixel)
 //  need to effectively rotate that matrix 90 degrees, bit by bit.
 void t6963ReadBlock(uint8_t x, uint8_t y, uint8_t *buffer)
 {
-  uint8_t firstColBuffer, secondColBuffer;
+  uint8_t colBuffer[2];
   uint8_t dataBuffer[8];
   for (uint8_t i = 0; i < 8; i++)
   {
-    t6963SetPointer(x,y+i); // This sets our pointer to the location containing
-                            //  the first pixel of interest.
-    t6963WriteCmd(0xc1);    // Read data command, increment pointer.
-    firstColBuffer = t6963ReadData(); // Read the data.
-    t6963WriteCmd(0xc5);    // Read data command, don't change pointer.
-    secondColBuffer = t6963ReadData(); // Read the data.
+    // Pull both bytes that hold this row of the block in one auto-read.
+    t6963ReadBurst(t6963RowAddress(y+i) + (x>>3), colBuffer, 2);
     // Okay, so now we have the data we're interested in. We'll need to
     //  bit-shift it; if the data spans two bytes, we need to put those two
     //  bytes into one.
-    dataBuffer[i] = firstColBuffer<<(x%8);
-    dataBuffer[i] |= secondColBuffer>>(8 - (x%8));
+    dataBuffer[i] = colBuffer[0]<<(x%8);
+    dataBuffer[i] |= colBuffer[1]>>(8 - (x%8));
   }
   // dataBuffer now contains the block data, with dataBuffer[0] being the top
   //  row. We need to make buffer[0] contain bit 0 of each of dataBuffer's
@@ -268,4 +561,7 @@ void t6963ReadBlock(uint8_t x, uint8_t y, uint8_t *buffer)
       buffer[i] |= (dataBuffer[j]&(0x01<<j));
     }
   } 
-}
\ No newline at end of file
+}
+
+// This is how lcd.c sees us; see LCD_DRIVER in glcdbp.h.
+const LCD_DRIVER t6963Driver PROGMEM = T6963_DRIVER;
@@ -21,6 +21,29 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 #define PIX_DK 0x00
 #define PIX_LT 0x08
 
+// Status register bits for the auto read/write modes. STA2 is "ready for the
+//  next auto read", STA3 is "ready for the next auto write".
+#define STA2   0x04
+#define STA3   0x08
+
+// How display memory is laid out. The modules have 8k of it; the graphics
+//  layer gets the first GRAPHIC_ROWS rows of 20 bytes, and the text layer,
+//  one byte per 8x8 character cell, gets TEXT_RING rows of cells after that.
+//  Both are a lot more than a screenful, so that scrolling can just move the
+//  home address down through them (see t6963Scroll()).
+#define GRAPHIC_ROWS 304
+#define TEXT_HOME  0x1800
+#define TEXT_COLS  20
+#define TEXT_ROWS  16
+#define TEXT_RING  96
+
+// Text layer modes for t6963TextMode(). Other than TEXT_OFF, these pick how
+//  the text layer is combined with the graphics layer.
+#define TEXT_OFF   0
+#define TEXT_OR    1
+#define TEXT_XOR   2
+#define TEXT_AND   3
+
 void     t6963WriteData(uint8_t data);
 uint8_t  t6963ReadData(void);
 void     t6963WriteCmd(uint8_t command);
@@ -32,6 +55,29 @@ void     t6963Clear(void);
 void     t6963DrawPixel(uint8_t x, uint8_t y, PIX_VAL pixel);
 void     t6963ReadBlock(uint8_t x, uint8_t y, uint8_t *buffer);
 void     t6963BitSR(uint8_t bit, uint8_t SR);
+void     t6963WriteBits(uint8_t x, uint8_t y, uint8_t set, uint8_t clear);
+void     t6963SetAddress(uint16_t pointerAddress);
+void     t6963WriteBurst(uint16_t addr, const uint8_t *src, uint16_t n);
+void     t6963FillBurst(uint16_t addr, uint8_t value, uint16_t n);
+void     t6963ReadBurst(uint16_t addr, uint8_t *dst, uint16_t n);
+void     t6963WriteRow(uint8_t x, uint8_t y, uint8_t width, const uint8_t *bits);
+void     t6963FillRow(uint8_t x, uint8_t y, uint8_t width, PIX_VAL pixel);
+void     t6963ReadBytes(uint8_t x, uint8_t y, uint8_t *dst, uint8_t n);
+void     t6963TextMode(uint8_t mode);
+void     t6963ClearText(void);
+void     t6963WriteText(uint8_t col, uint8_t row, char printMe);
+void     t6963Scroll(void);
+void     t6963ScrollText(void);
+
+// The driver descriptor (see LCD_DRIVER in glcdbp.h). As with the ks0108b,
+//  it lives here so a single-display build can use it as a constant. There's
+//  nothing to flush; everything goes straight to display memory.
+#define T6963_DRIVER {160, 128, LAYOUT_ROWS, t6963DisplayInit, t6963Clear, \
+                      0, t6963ReadBytes, t6963WriteBits, t6963WriteRow,    \
+                      t6963FillRow, t6963ReadBlock, t6963TextMode,         \
+                      t6963ClearText, t6963WriteText, t6963Scroll,         \
+                      t6963ScrollText}
+extern const LCD_DRIVER t6963Driver;
 
 #endif
 
@@ -43,9 +89,12 @@ breaks up its memory space into 8-pixel columns, and that's it.
 The T6963 is a much more advanced system. It has a much larger memory space,
 allowing for multiple displays to be stored and all-at-once display flips to
 occur by simply changing a pointer. It has built in text/character generation.
-We're going to ignore basically all the advanced features, and concentrate on
-text mode only. That's kind of a bummer, because the advance features are cool,
-but doing things this way keeps the code easy.
+We're going to ignore most of the advanced features, and concentrate on
+graphics mode. That's kind of a bummer, because the advance features are cool,
+but doing things this way keeps the code easy. The one exception is the text
+layer: the built-in character generator can be turned on (see t6963TextMode())
+to overlay 8x8 text cells on the graphics, which is much cheaper than drawing
+characters pixel by pixel.
 
 Finally, rather than rows of columns 8 pixels high, the T6963 is broken up into
 rows one pixel high and of a width defined by the user. Within that row, each
@@ -12,21 +12,24 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 
 ***************************************************************************/
 
+#include <util/atomic.h>
+#include <util/crc16.h>
 #include "ui.h"
 #include "lcd.h"
 #include "serial.h"
 #include "glcdbp.h"
 #include "nvm.h"
 #include "demo.h"
+#include "benchmark.h"
 
-// These variables are defined in glcdbp.c, and are used for the input buffer
-//   from the serial port. We need to be able to access them here because we'll
-//   be stuck here parsing input from the serial port once a command comes in.
-extern volatile uint8_t 	rxRingBuffer[BUF_DEPTH];
-extern volatile uint16_t 	rxRingHead;
-extern volatile uint16_t	rxRingTail;
-extern volatile uint8_t	  bufferSize;
+// These variables are defined in glcdbp.c. The serial input buffer itself is
+//   accessed through the functions in serial.c; the counters are here so we
+//   can report on them.
 extern volatile uint8_t   reverse;
+extern uint8_t            flowControl;
+extern volatile uint16_t  rxOverflows;
+extern volatile uint16_t  rxOverruns;
+extern volatile uint8_t   rxHighWater;
 
 // These variables are defined in lcd.c, and form the backbone of the pseudo
 //  terminal text handling system.
@@ -37,293 +40,577 @@ extern uint8_t  yDim;
 extern uint8_t  xDim;
 
 
-// This is a state machine that acts based on the received command from the
-//  main program loop.
-void uiStateMachine(char command)
+// Each command is an opcode (the byte after the '|'), the number of argument
+//  bytes it needs, and the function that carries it out. The handler doesn't
+//  run until all of its arguments are sitting in the serial buffer; then we
+//  copy them out all at once, so they're not taking up room in the buffer
+//  while the command runs, and the handler reads them with uiArg(). To add a
+//  command, write a handler and add a line here. No command can have more
+//  than UI_MAX_ARGS arguments.
+typedef struct
 {
-  // Up to five characters may be needed to describe any single operation.
-  char cmdBuffer[5];
-  // We'll want to track how far we've moved through our buffered command
-  //  bytes once we've received them all.
-  uint8_t cmdBufferPtr = 0;
-  // We will *assume* a state of ON for pixel values; we can clear that later.
-  PIX_VAL pixel = ON;
-  // Now, let's figure out where to start, based on our command input. There's
-  //  a lot of good information about the switch constants in the header file.
+  uint8_t opcode;
+  uint8_t argCount;
+  void    (*handler)(void);
+} UI_COMMAND;
 
-  switch(command)
+static void uiRunDemo(void);
+static void uiToggleBgnd(void);
+static void uiAdjBlLevel(void);
+static void uiAdjBaudRate(void);
+static void uiAdjTextX(void);
+static void uiAdjTextY(void);
+static void uiDrawPixel(void);
+static void uiDrawLine(void);
+static void uiDrawCircle(void);
+static void uiDrawBox(void);
+static void uiEraseBlock(void);
+static void uiDrawSprite(void);
+static void uiTextLayer(void);
+static void uiFlowControl(void);
+static void uiQueryStatus(void);
+static void uiAckMode(void);
+static void uiFrameMode(void);
+static void uiBlit(void);
+static void uiUpdate(void);
+static void uiSetClip(void);
+static void uiFillBox(void);
+static void uiKsTiming(void);
+static void uiScrollMode(void);
+
+static const UI_COMMAND commandTable[] PROGMEM =
+{
+  {CLEAR_SCREEN,  0, lcdClearScreen},
+  {RUN_DEMO,      0, uiRunDemo},
+  {TOGGLE_BGND,   0, uiToggleBgnd},
+  {TOGGLE_SPLASH, 0, toggleSplash},
+  {ADJ_BL_LEVEL,  1, uiAdjBlLevel},
+  {ADJ_BAUD_RATE, 1, uiAdjBaudRate},
+  {ADJ_TEXT_X,    1, uiAdjTextX},
+  {ADJ_TEXT_Y,    1, uiAdjTextY},
+  {DRAW_PIXEL,    3, uiDrawPixel},
+  {DRAW_LINE,     5, uiDrawLine},
+  {DRAW_CIRCLE,   4, uiDrawCircle},
+  {DRAW_BOX,      5, uiDrawBox},
+  {ERASE_BLOCK,   4, uiEraseBlock},
+  {DRAW_SPRITE,   5, uiDrawSprite},
+  {TEXT_LAYER,    1, uiTextLayer},
+  {FLOW_CONTROL,  1, uiFlowControl},
+  {QUERY_STATUS,  0, uiQueryStatus},
+  {ACK_MODE,      1, uiAckMode},
+  {FRAME_MODE,    0, uiFrameMode},
+  {BLIT,          4, uiBlit},
+  {UPDATE,        5, uiUpdate},
+  {SET_CLIP,      4, uiSetClip},
+  {FILL_BOX,      5, uiFillBox},
+  {BENCHMARK,     0, benchmark},
+  {KS_TIMING,     2, uiKsTiming},
+  {SCROLL_MODE,   1, uiScrollMode},
+};
+
+// Where we are in parsing the input stream. These have to outlive any one
+//  call to uiStateMachine(), since a command may arrive a byte at a time.
+static uint8_t uiEscaped = 0;   // Last byte was a '|'; next is an opcode.
+static uint8_t uiArgCount = 0;  // How many argument bytes pendingHandler
+                                //  needs to see before it can run.
+static void    (*pendingHandler)(void) = 0;
+static uint8_t uiArgs[UI_MAX_ARGS];
+static uint8_t ackMode = 0;     // 0 = off, 1 = ACK, 2 = ACK + sequence number
+static uint8_t ackSeq = 0;
+static uint8_t frameMode = 0;       // Are we taking framed input?
+static uint8_t frameRemaining = 0;  // Bytes left in the current frame,
+                                    //  counting the CRC; 0 = between frames.
+static uint16_t frameErrors = 0;    // Frames thrown out for a bad CRC or
+                                    //  length.
+// Some commands (BLIT, for one) are followed by more data than will fit in
+//  the serial buffer. Their handlers set this up, and then the data gets fed
+//  to streamHandler as it comes in- no more than 'avail' bytes at a time-
+//  until it decides it's seen it all and clears streamHandler. It returns how
+//  many bytes it used.
+static uint8_t  (*streamHandler)(uint8_t avail) = 0;
+static uint16_t streamRemaining = 0;  // Image bytes still to come.
+static uint8_t  streamOp;             // BLIT_COPY, BLIT_XOR or
+                                      //  UPDATE_DISCARD.
+// What to tell the host when the command that's running finishes. A handler
+//  that turns its arguments down sets this to NAK.
+static uint8_t  commandReply = ACK;
+// Run-length decoder state for UPDATE.
+static uint8_t  rleCount = 0;         // Bytes left in the current run.
+static uint8_t  rleRepeat;            // Is it a repeat, or literal bytes?
+static uint8_t  rleHaveValue;         // Have we got the byte to repeat yet?
+static uint8_t  rleValue;
+
+// Fetch argument n of the command currently being executed.
+static uint8_t uiArg(uint8_t n)
+{
+  return uiArgs[n];
+}
+
+// Tell the host we're done with a command, if it asked us to.
+static void uiAck(uint8_t response)
+{
+  if (ackMode == 0) return;
+  putChar(response);
+  if (ackMode == 2) putChar(ackSeq);
+  ackSeq++;
+  // An XON/XOFF host can't tell a sequence number from flow control, and a
+  //  stray XOFF would stop it for good, so those two numbers get skipped.
+  if ((flowControl & FLOW_XONXOFF) && ((ackSeq == XON) || (ackSeq == XOFF)))
+    ackSeq++;
+}
+
+// A command (and its data stream, if it has one) is done; let the host know
+//  how it went.
+static void uiFinish(void)
+{
+  uiAck(commandReply);
+  commandReply = ACK;
+}
+
+// Look up an opcode in the command table and get ready to run it. Returns 0
+//  if there's no such command.
+static uint8_t uiLookup(uint8_t opcode)
+{
+  for (uint8_t i = 0; i < sizeof(commandTable)/sizeof(UI_COMMAND); i++)
   {
-    case CLEAR_SCREEN:  // Easy and fairly self-explanatory.
-    lcdClearScreen();
-    break;
-    
-    case RUN_DEMO:      // Some sort of wonky song-and-dance to show off.
-    lcdClearScreen();
-    demo();
-    reverse ^= 0x01;
-    lcdClearScreen();
-    demo();
-    reverse ^= 0x01;
-    lcdClearScreen();
-    break;
-    
-    case TOGGLE_BGND:   // Switch between reverse mode and normal mode.
-      reverse ^= 0x01;
-      toggleReverse();
-      lcdClearScreen();
-    break;
-    
-    case TOGGLE_SPLASH: // Turn the splash-on-startup SparkFun logo off.
-      toggleSplash();
-    break;
+    if (pgm_read_byte(&commandTable[i].opcode) == opcode)
+    {
+      uiArgCount = pgm_read_byte(&commandTable[i].argCount);
+      pendingHandler = (void (*)(void))pgm_read_word(&commandTable[i].handler);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Something was wrong with a frame; throw away count bytes of it and make a
+//  note of it.
+static void uiFrameError(uint8_t count)
+{
+  serialBufferDrop(count);
+  frameRemaining = 0;
+  frameErrors++;
+  uiAck(NAK);
+}
+
+// We're in framed mode and about to start a new frame, so the next byte is a
+//  length. Check the whole frame before we do anything with it. Returns 0 if
+//  we have to wait for more of the frame to come in.
+static uint8_t uiFrameStart(void)
+{
+  uint8_t len = serialBufferPeek(0);
+  if (len == 0)               // A zero length takes us out of framed mode.
+  {
+    serialBufferDrop(1);
+    frameMode = 0;
+    return 1;
+  }
+  if (len > FRAME_MAX_LEN)    // This can't be a real frame; we'd never be able
+  {                           //  to buffer it all. Skip the length byte and
+    uiFrameError(1);          //  hope the next one makes more sense.
+    return 1;
+  }
+  if (serialBufferCount() < len + 2) return 0;
+  
+  // The CRC covers the length byte as well as the payload, so a mangled length
+  //  gets caught too.
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i <= len; i++)
+  {
+    crc = _crc8_ccitt_update(crc, serialBufferPeek(i));
+  }
+  if (crc != (uint8_t)serialBufferPeek(len + 1))
+  {
+    uiFrameError(len + 2);
+    return 1;
+  }
+  serialBufferDrop(1);
+  frameRemaining = len + 1;   // The payload, plus the CRC on the end.
+  return 1;
+}
+
+// This is a state machine that chews through whatever the host has sent us
+//  so far. Printable characters get drawn; a '|' means the next byte is a
+//  command. It never waits for data- if a command's arguments haven't all
+//  arrived yet, it remembers where it was and returns, and picks up from
+//  there the next time it's called.
+// In framed mode, there's no '|'; any byte below 0x20 that's a command is a
+//  command (except \r and \b), and everything else is text.
+void uiStateMachine(void)
+{
+  while (1)
+  {
+    // If we're waiting on arguments for a command, that's all we can do.
+    if (pendingHandler)
+    {
+      if (serialBufferCount() < uiArgCount) return;
+      serialBufferPeekBlock(uiArgs, 0, uiArgCount);
+      serialBufferDrop(uiArgCount);
+      pendingHandler();
+      pendingHandler = 0;
+      if (streamHandler == 0) uiFinish();
+      continue;
+    }
     
-    case ADJ_BL_LEVEL:  // The first real, meaty command. Adjust the backlight.
-      while(1)  // Stay here until we are *told* to leave.
-      {
-        // If there's data in the serial buffer, move it to the cmdBuffer.
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // This command is a one-byte command; once the count of bytes in the
-        //  command buffer is greater than 0, we want to parse the command.
-        if (cmdBufferPtr > 0)
-        {
-          cmdBufferPtr = 0;  // Reset the command buffer pointer.
-          // We need to make sure our level never exceeds 100, or weird
-          //   things can happen to the PWM generator.
-          if ((uint8_t)cmdBuffer[0] > 100) cmdBuffer[0] = 100;
-          // Set the backlight level- this is an alias to the actual register,
-          //  renamed for convenience.
-          BL_LEVEL = cmdBuffer[0];
-          // Store the new value in EEPROM.
-          setBacklightLevel(cmdBuffer[0]);
-          break; // This is where we tell to code to leave the while loop.
-        }
-      }
-    break;
+    // All that's left of the current frame is the CRC, which we've already
+    //  checked.
+    if (frameRemaining == 1)
+    {
+      serialBufferDrop(1);
+      frameRemaining = 0;
+      continue;
+    }
     
-    case ADJ_BAUD_RATE:
-      while(1)  // Stay here until we are *told* to leave.
-      {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // Again, a one-byte command. Once we have a byte in the cmdBuffer,
-        //  parse it.
-        if (cmdBufferPtr > 0)
-        {
-          cmdBufferPtr = 0;
-          setBaudRate(cmdBuffer[0]); // This will reject invalid settings,
-                                     //   which is to say, anything outside
-                                     //   of the range ASCII 1-6.
-          switch(cmdBuffer[0])
-          {
-            case '1':
-            serialInit(BR4800);
-            break;
-            case '2':
-            serialInit(BR9600);
-            break;
-            case '3':
-            serialInit(BR19200);
-            break;
-            case '4':
-            serialInit(BR38400);
-            break;
-            case '5':
-            serialInit(BR57600);
-            break;
-            case '6':
-            serialInit(BR115200);
-            break;
-            default: // If we have an invalid entry, we'll just ignore it.
-            break;
-          }
-          break; // This is where we tell to code to leave the while loop.
-        }
-      }
-    break;
+    if (serialBufferCount() == 0) return;
     
-    case ADJ_TEXT_X: // This is the x-origin of our text "window".
-      while(1)  // Stay here until we are *told* to leave.
-      {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // Again, one-byte command.
-        if (cmdBufferPtr > 0)
-        {
-          cmdBufferPtr = 0;
-          // The most recent byte is the new X origin of the text window- IF it
-          //   makes sense. It only makes sense if it is at least 6 pixels from
-          //   the right edge of the screen. We use the xDim variable from
-          //   lcd.c to make sure we don't botch that. Ignore invalid input.
-          if (cmdBuffer[0] <= (xDim-6))
-          {
-            textOrigin[0] = cmdBuffer[0];
-            cursorPos[0] = textOrigin[0];
-            textLength = 0;
-          }
-          break; // This is where we tell to code to leave the while loop.
-        }
-      }
-    break;
+    if (frameMode && (frameRemaining == 0))
+    {
+      if (uiFrameStart() == 0) return;
+      continue;
+    }
     
-    case ADJ_TEXT_Y:
-      while(1)  // Stay here until we are *told* to leave.
-      {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // One byte command.
-        if (cmdBufferPtr > 0)
-        {
-          cmdBufferPtr = 0;
-          // The most recent byte is the new Y origin of the text window- IF it
-          //   makes sense. It only makes sense if it is at least 8 pixels from
-          //   the bottom edge of the screen. Use the yDim variable from lcd.c
-          //   to make sure we don't botch that. Ignore invalid input.
-          if (cmdBuffer[0] <= (yDim-8))
-          {
-            textOrigin[1] = cmdBuffer[0];
-            cursorPos[1] = textOrigin[1];
-            textLength = 0;
-          }
-          break; // This is where we tell to code to leave the while loop.
-        }
-      }
-    break;
+    // Feed a command's data stream. In framed mode, a stream can't take the
+    //  CRC at the end of the frame, but it can carry on into the next frame.
+    if (streamHandler)
+    {
+      uint8_t avail = frameMode ? (frameRemaining - 1) : serialBufferCount();
+      uint8_t used = streamHandler(avail);
+      if (frameMode) frameRemaining -= used;
+      if (streamHandler == 0) uiFinish();
+      else if (used == 0) return;
+      continue;
+    }
     
-    case DRAW_PIXEL:
-      while(1)  // Stay here until we are *told* to leave.
+    if (frameMode)
+    {
+      char bufferChar = serialBufferPop();
+      frameRemaining--;
+      if ((uint8_t)bufferChar >= ' ' ||
+          (bufferChar == '\r') ||
+          (bufferChar == '\b') )
       {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // This is a three-value command- x, y, ON/OFF.
-        if (cmdBufferPtr > 2)
-        {
-          cmdBufferPtr = 0;
-          // If the user *specifically* sends a 0 for the third byte, turn
-          //  the pixel off. Otherwise, turn it on.
-          if (cmdBuffer[2] == 0) pixel = OFF;
-          lcdDrawPixel(cmdBuffer[0], cmdBuffer[1], pixel);
-          break; // This is where we tell to code to leave the while loop.
-        }
+        if ((uint8_t)bufferChar <= '~') lcdDrawChar(bufferChar);
       }
-    break;
-    
-    case DRAW_LINE:      
-    while(1)  // Stay here until we are *told* to leave.
+      // A line feed is ignored, same as outside a frame, so "\r\n" line
+      //  endings do the same thing either way.
+      else if (bufferChar == '\n') continue;
+      else if (uiLookup(bufferChar) == 0) uiAck(NAK);
+      // A command can't take its arguments from past the end of the frame.
+      //  The host must've built the frame wrong; bail out on the rest of it.
+      else if (uiArgCount >= frameRemaining)
       {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // Five-byte command.
-        if (cmdBufferPtr > 4)
-        {
-          cmdBufferPtr = 0;
-          // Same sort of logic- if the user sends a 0 for the pixel value,
-          //  turn pixels off, otherwise, turn them on.
-          if (cmdBuffer[4] == 0) pixel = OFF;
-          lcdDrawLine(cmdBuffer[0], cmdBuffer[1], // start point x,y
-                      cmdBuffer[2], cmdBuffer[3], // end point x,y
-                      pixel);                     // draw or erase?
-          break; // This is where we tell to code to leave the while loop.
-        }
+        pendingHandler = 0;
+        uiFrameError(frameRemaining);
       }
+      else frameRemaining -= uiArgCount;
+      continue;
+    }
     
-    break;
+    char bufferChar = serialBufferPop();
     
-    case DRAW_CIRCLE:      
-    while(1)  // Stay here until we are *told* to leave.
-      {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // Four-byte command.
-        if (cmdBufferPtr > 3)
-        {
-          cmdBufferPtr = 0;
-          if (cmdBuffer[3] == 0) pixel = OFF;
-          lcdDrawCircle(cmdBuffer[0], cmdBuffer[1], // center point x,y
-                        cmdBuffer[2],               // radius
-                        pixel);                     // draw or erase?
-          break; // This is where we tell to code to leave the while loop.
-        }
-      }
- 
-    break;
-    
-    case DRAW_BOX:    
-    while(1)  // Stay here until we are *told* to leave.
+    // If the last character was the command escape character ('|'), this one
+    //  tells us what to do. Look it up; if the character that followed the
+    //  '|' is not a valid command, ignore it.
+    if (uiEscaped)
+    {
+      uiEscaped = 0;
+      if (uiLookup(bufferChar) == 0) uiAck(NAK);
+    }
+    else if (bufferChar == '|') uiEscaped = 1;
+    // Otherwise, draw the character. lcdDrawChar also handles backspace and
+    //   carriage return; a line feed gets ignored.
+    else if (((bufferChar >= ' ') && (bufferChar <= '~')) ||
+             (bufferChar == '\r') ||  // Newline.
+             (bufferChar == '\b') )   // Backspace.
+      lcdDrawChar(bufferChar);
+  }
+}
+
+// Some sort of wonky song-and-dance to show off.
+static void uiRunDemo(void)
+{
+  lcdClearScreen();
+  demo();
+  reverse ^= 0x01;
+  lcdClearScreen();
+  demo();
+  reverse ^= 0x01;
+  lcdClearScreen();
+}
+
+// Switch between reverse mode and normal mode.
+static void uiToggleBgnd(void)
+{
+  reverse ^= 0x01;
+  toggleReverse();
+  lcdClearScreen();
+}
+
+// The first real, meaty command. Adjust the backlight.
+static void uiAdjBlLevel(void)
+{
+  uint8_t level = uiArg(0);
+  // We need to make sure our level never exceeds 100, or weird things can
+  //   happen to the PWM generator.
+  if (level > 100) level = 100;
+  // Set the backlight level- this is an alias to the actual register, renamed
+  //  for convenience.
+  BL_LEVEL = level;
+  // Store the new value in EEPROM.
+  setBacklightLevel(level);
+}
+
+static void uiAdjBaudRate(void)
+{
+  setBaudRate(uiArg(0));   // This will reject invalid settings, which is to
+                           //   say, anything outside of the range ASCII 0-9.
+  serialSetBaud(uiArg(0)); // As will this.
+}
+
+// This is the x-origin of our text "window". It only makes sense if it is at
+//  least 6 pixels from the right edge of the screen. We use the xDim variable
+//  from lcd.c to make sure we don't botch that. Ignore invalid input.
+static void uiAdjTextX(void)
+{
+  if (uiArg(0) <= (xDim-6))
+  {
+    textOrigin[0] = uiArg(0);
+    cursorPos[0] = textOrigin[0];
+    textLength = 0;
+  }
+}
+
+// Same deal, for the y-origin. It only makes sense if it is at least 8 pixels
+//  from the bottom edge of the screen.
+static void uiAdjTextY(void)
+{
+  if (uiArg(0) <= (yDim-8))
+  {
+    textOrigin[1] = uiArg(0);
+    cursorPos[1] = textOrigin[1];
+    textLength = 0;
+  }
+}
+
+// For all the drawing commands, if the user *specifically* sends a 0 for the
+//  pixel value, turn the pixels off. Otherwise, turn them on.
+static PIX_VAL uiPixel(uint8_t n)
+{
+  if (uiArg(n) == 0) return OFF;
+  return ON;
+}
+
+static void uiDrawPixel(void)   // x, y, ON/OFF
+{
+  lcdDrawPixel(uiArg(0), uiArg(1), uiPixel(2));
+}
+
+static void uiDrawLine(void)
+{
+  lcdDrawLine(uiArg(0), uiArg(1), // start point x,y
+              uiArg(2), uiArg(3), // end point x,y
+              uiPixel(4));        // draw or erase?
+}
+
+static void uiDrawCircle(void)
+{
+  lcdDrawCircle(uiArg(0), uiArg(1), // center point x,y
+                uiArg(2),           // radius
+                uiPixel(3));        // draw or erase?
+}
+
+static void uiDrawBox(void)
+{
+  lcdDrawBox(uiArg(0), uiArg(1), // start point x,y
+             uiArg(2), uiArg(3), // end point x,y
+             uiPixel(4));        // draw or erase?
+}
+
+static void uiFillBox(void)
+{
+  lcdFillRect(uiArg(0), uiArg(1), // start point x,y
+              uiArg(2), uiArg(3), // end point x,y
+              uiPixel(4));        // fill or erase?
+}
+
+static void uiEraseBlock(void)
+{
+  lcdEraseBlock(uiArg(0), uiArg(1),  // start point x,y
+                uiArg(2), uiArg(3)); // end point x,y
+}
+
+static void uiDrawSprite(void)
+{
+  lcdDrawSprite(uiArg(0), uiArg(1), // upper left x,y
+                uiArg(2),           // sprite index
+                uiArg(3),           // rotation angle
+                uiPixel(4));        // draw or erase?
+}
+
+static void uiSetClip(void)
+{
+  lcdSetClip(uiArg(0), uiArg(1),  // one corner x,y
+             uiArg(2), uiArg(3)); // the opposite corner x,y
+}
+
+// The ks0108b timing profile goes in EEPROM, and the driver picks it up the
+//  next time it starts. Changing it on the fly could leave the panel in the
+//  middle of a strobe that's suddenly too short.
+static void uiKsTiming(void)
+{
+  setKsTiming(uiArg(0), uiArg(1));
+}
+
+static void uiTextLayer(void)
+{
+  lcdSetTextLayer(uiArg(0)); // Ignores invalid modes, and the small display.
+}
+
+static void uiScrollMode(void)
+{
+  lcdSetScroll(uiArg(0));
+}
+
+// Turn flow control on or off. If we'd already told the host to stop, this
+//  won't tell it to go again until the buffer drains, so don't change modes
+//  in the middle of a burst.
+static void uiFlowControl(void)
+{
+  flowControl = uiArg(0) & (FLOW_XONXOFF | FLOW_RTS);
+  setFlowControl(flowControl);
+}
+
+// Report back on how the serial input is holding up: seven bytes, laid out
+//  as in ui.h. The receive counters are written by the receive interrupt, so
+//  we take a snapshot with interrupts off; the 16-bit ones could change
+//  halfway through being read otherwise. frameErrors is ours alone.
+static void uiQueryStatus(void)
+{
+  uint16_t overflows, overruns;
+  uint8_t highWater;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    overflows = rxOverflows;
+    overruns = rxOverruns;
+    highWater = rxHighWater;
+  }
+  putChar(overflows>>8);
+  putChar(overflows & 0xff);
+  putChar(overruns>>8);
+  putChar(overruns & 0xff);
+  putChar(highWater);
+  putChar(frameErrors>>8);
+  putChar(frameErrors & 0xff);
+}
+
+// Turn acknowledge mode on or off. The sequence starts over either way.
+static void uiAckMode(void)
+{
+  if (uiArg(0) > 2) return;
+  ackMode = uiArg(0);
+  ackSeq = 0;
+}
+
+// Switch over to framed input. The next byte is the length of the first
+//  frame. This does nothing inside a frame, since we're already there.
+static void uiFrameMode(void)
+{
+  frameMode = 1;
+}
+
+// Feed the next piece of a blit out to the display.
+static uint8_t uiBlitStream(uint8_t avail)
+{
+  uint8_t chunk[16];
+  if (avail > sizeof(chunk)) avail = sizeof(chunk);
+  if (avail > streamRemaining) avail = streamRemaining;
+  serialBufferPeekBlock(chunk, 0, avail);
+  serialBufferDrop(avail);
+  lcdBlitWrite(chunk, avail, BLIT_COPY);
+  streamRemaining -= avail;
+  if (streamRemaining == 0) streamHandler = 0;
+  return avail;
+}
+
+static void uiBlit(void)
+{
+  streamRemaining = lcdBlitBegin(uiArg(0), uiArg(1), // upper left x,y
+                                 uiArg(2), uiArg(3)); // width, height
+  if (streamRemaining) streamHandler = uiBlitStream;
+}
+
+// Unpack as much of a run-length encoded image as we've got, and draw it. We
+//  only ever hold 16 bytes of the image at once; a repeat run can expand to
+//  far more than that, so we draw whenever the buffer fills up, and keep
+//  going until we either run out of input or finish the image.
+static uint8_t uiUpdateStream(uint8_t avail)
+{
+  uint8_t out[16];
+  uint8_t n = 0;
+  uint8_t used = 0;
+  while (streamRemaining > n)
+  {
+    if (n == sizeof(out))
+    {
+      if (streamOp != UPDATE_DISCARD) lcdBlitWrite(out, n, streamOp);
+      streamRemaining -= n;
+      n = 0;
+      continue;
+    }
+    if (rleCount == 0)              // Start of a run.
+    {
+      if (used == avail) break;
+      uint8_t control = serialBufferPeek(used++);
+      if (control & 0x80)
       {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // Five-byte command.
-        if (cmdBufferPtr > 4)
-        {
-          cmdBufferPtr = 0;
-          if (cmdBuffer[4] == 0) pixel = OFF;
-          lcdDrawBox(cmdBuffer[0], cmdBuffer[1], // start point x,y
-                     cmdBuffer[2], cmdBuffer[3], // end point x,y
-                     pixel);                     // draw or erase?
-          break; // This is where we tell to code to leave the while loop.
-        }
+        rleCount = control - 0x7e;  // 0x80-0xff repeat 2-129 times...
+        rleRepeat = 1;
+        rleHaveValue = 0;
       }
-    
-    break;
-    
-    case ERASE_BLOCK:    
-    while(1)  // Stay here until we are *told* to leave.
+      else
       {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // Four-byte command.
-        if (cmdBufferPtr > 3)
-        {
-          cmdBufferPtr = 0;
-          lcdEraseBlock(cmdBuffer[0], cmdBuffer[1], // start point x,y
-                        cmdBuffer[2], cmdBuffer[3]); // end point x,y
-          break; // This is where we tell to code to leave the while loop.
-        }
+        rleCount = control + 1;     // ...and 0x00-0x7f are 1-128 literals.
+        rleRepeat = 0;
       }
-    break;    
-    
-    case DRAW_SPRITE:      
-    while(1)  // Stay here until we are *told* to leave.
+      continue;
+    }
+    if (rleRepeat)
+    {
+      if (rleHaveValue == 0)
       {
-        if (bufferSize > 0)
-        {
-          cmdBuffer[cmdBufferPtr++] = serialBufferPop();
-        }
-        // Five-byte command.
-        if (cmdBufferPtr > 4)
-        {
-          cmdBufferPtr = 0;
-          if (cmdBuffer[4] == 0) pixel = OFF;
-          lcdDrawSprite(cmdBuffer[0], cmdBuffer[1], // upper left x,y
-                        cmdBuffer[2],               // sprite index
-                        cmdBuffer[3],               // rotation angle
-                        pixel);                     // draw or erase?
-          break; // This is where we tell to code to leave the while loop.
-        }
+        if (used == avail) break;
+        rleValue = serialBufferPeek(used++);
+        rleHaveValue = 1;
       }
- 
-    break;
-    
-    default: // if the character that followed the '|' is not a valid command,
-    break;   //  ignore it.
+      out[n++] = rleValue;
+    }
+    else
+    {
+      if (used == avail) break;
+      out[n++] = serialBufferPeek(used++);
+    }
+    rleCount--;
+  }
+  serialBufferDrop(used);
+  if (streamOp != UPDATE_DISCARD) lcdBlitWrite(out, n, streamOp);
+  streamRemaining -= n;
+  if (streamRemaining == 0) streamHandler = 0;
+  return used;
+}
+
+// An invalid mode still has an image coming after it, and there's no telling
+//  how long that is without decoding it. So we decode it anyway, throw it
+//  away rather than drawing it, and NAK the lot.
+static void uiUpdate(void)
+{
+  streamOp = uiArg(4);
+  if (streamOp > BLIT_XOR)
+  {
+    streamOp = UPDATE_DISCARD;
+    commandReply = NAK;
   }
+  rleCount = 0;
+  streamRemaining = lcdBlitBegin(uiArg(0), uiArg(1), // upper left x,y
+                                 uiArg(2), uiArg(3)); // width, height
+  if (streamRemaining) streamHandler = uiUpdateStream;
 }
@@ -39,6 +39,13 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
                             '4' = 38400bps
                             '5' = 57600bps
                             '6' = 115200bps (default)
+                            '7' = 230400bps
+                            '8' = 250000bps
+                            '9' = 500000bps
+                            '0' = 1000000bps
+                            At 500k and up, bytes arrive faster than most
+                            drawing commands finish, so turn on flow control
+                            (CTRL-w) if you're going to stream.
   'CTRL-x'       (0x18) - Change the text cursor x position
   'CTRL-y'       (0x19) - Change the text cursor y position
                             For both of these commands, the next byte reflects
@@ -68,6 +75,10 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
                             points of a diagonal line across the box; pixels
                             inside that box (including the border) will be
                             set to the background color.
+  'CTRL-f'       (0x06) - Draw (or erase) a filled box. Expects five bytes:
+                            two sets of x,y coordinates for opposite corners,
+                            and 0x00 or 0x01 for erase/draw. Like erase block,
+                            but it can fill, too.
   'CTRL-k'       (0x0b) - Draw a sprite. Expects five bytes- x and y of upper
                             left corner of the 8x8 sprite (unlike text, there
                             is no wrapping or edge detection- pixels off screen
@@ -77,10 +88,154 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
                             un rotated, '3' is 90 deg clockwise, '6' is upside
                             down, and '9' is 90 deg anticlockwise), and last is
                             a zero or non-zero byte for erase or draw pixels.
+  'CTRL-t'       (0x14) - Text layer (160x128 display only). Expects one byte:
+                            0x00 = off; text is drawn into the graphics with
+                                   our own 5x7 font (default)
+                            0x01 = on, text ORed with the graphics
+                            0x02 = on, text XORed with the graphics
+                            0x03 = on, text ANDed with the graphics
+                            With the text layer on, characters come from the
+                            display's own character generator and snap to
+                            8x8 cells. Clearing the screen clears both layers.
+  'CTRL-w'       (0x17) - Flow control. Nonvolatile. Expects one byte:
+                            0x00 = none (default)
+                            0x01 = XON/XOFF; we send XOFF (0x13) when the
+                                   input buffer is getting full and XON (0x11)
+                                   when there's room again
+                            0x02 = RTS on PB4 (pin 1 of the ISP header); high
+                                   means stop sending, low means go
+                            0x03 = both
+                            The host can send 64 more bytes after being told
+                            to stop before anything gets dropped. Note that
+                            XON/XOFF bytes can land in the middle of a status
+                            report (below), so use RTS if you need both.
+  'CTRL-v'       (0x16) - Set the clip rectangle. Expects four bytes: two sets
+                            of x,y coordinates for opposite corners of the
+                            box. After this, pixels, lines, circles, boxes,
+                            erased blocks, sprites, text and images only draw
+                            inside that box (edges included). Send 0,0,255,255
+                            to go back to the whole screen, which is what we
+                            start with. Clear screen still clears everything,
+                            and the t6963 text layer isn't clipped.
+  'CTRL-a'       (0x01) - Acknowledge mode. Expects one byte:
+                            0x00 = off (default)
+                            0x01 = send ACK (0x06) when each command finishes
+                            0x02 = send ACK followed by an 8-bit sequence
+                                   number, which counts up from 0 with each
+                                   command
+                            In either mode, a '|' followed by a byte that
+                            isn't a command gets NAK (0x15) instead, so the
+                            count always comes out right. The command that
+                            turns acks on is acknowledged (sequence 0), the
+                            one that turns them off isn't. Text isn't
+                            acknowledged, only commands. Not stored in EEPROM.
+                            With XON/XOFF flow control on (CTRL-w), the
+                            sequence skips 0x11 and 0x13, so it can't be
+                            mistaken for XON or XOFF.
+  'CTRL-n'       (0x0e) - Framed mode. Everything after this comes in frames:
+                            1 byte    - length of the payload, 1 to 190 bytes
+                            n bytes   - payload
+                            1 byte    - CRC-8 (polynomial 0x07, starting from
+                                        0) of the length byte and payload
+                            The payload is commands and text, without the
+                            '|': any byte below 0x20 (other than \r, \n and
+                            \b) is an opcode from this list, followed by its
+                            arguments, and anything else is text- including
+                            '|', which finally gets printed. \n is ignored,
+                            just as it is outside a frame. Nothing in a
+                            frame runs until the whole frame has arrived and
+                            its CRC checks out; frames that don't are thrown
+                            out and counted (see CTRL-q), and get a NAK in
+                            acknowledge mode. A length byte of 0 goes back to
+                            normal mode; if a length byte gets garbled and we
+                            lose our place, sending a handful of 0x00 bytes
+                            and then starting over with '|' CTRL-n gets things
+                            back in step.
+  'CTRL-i'       (0x09) - Blit a bitmap. Expects four bytes- x and y of the
+                            upper left corner, width and height- and then the
+                            image, one bit per pixel, 1 for draw and 0 for
+                            erase. The image is sent in bands 8 rows tall,
+                            top to bottom; each band is one byte per column,
+                            left to right, with bit 0 the top pixel. That's
+                            width * ((height+7)/8) bytes, so a full 128x64
+                            screen is 1024. If the height isn't a multiple of
+                            8, the last band's unused bits are ignored; parts
+                            of the image that fall off the screen are dropped.
+                            In framed mode, the image can run on across as
+                            many frames as it takes.
+  'CTRL-u'       (0x15) - Compressed image update. Expects five bytes- x, y,
+                            width and height, like CTRL-i, and then a mode:
+                            0x00 = the image itself
+                            0x01 = the difference between the image and
+                                   what's on the screen now, XORed together;
+                                   1 bits flip a pixel, 0 bits leave it be
+                            After that comes the image (or difference) in the
+                            same layout as CTRL-i, run-length encoded. Each
+                            run starts with a control byte:
+                            0x00-0x7f - copy the next 1-128 bytes as is
+                            0x80-0xff - repeat the next byte 2-129 times
+                            A run can carry on past the end of a band. A
+                            screen that's mostly unchanged is mostly runs of
+                            zeroes in difference mode, which cost two bytes
+                            per 129 and aren't even drawn. An invalid mode
+                            gets a NAK in acknowledge mode; the image after it
+                            is still read, but thrown away.
+  'CTRL-z'       (0x1a) - Benchmark. Times a fixed set of drawing jobs on the
+                            attached display: a clear, 100 characters, 50
+                            lines and 20 sprites. Sends back a count byte (4)
+                            and then four 16-bit results, high byte first:
+                            microseconds per clear, per character, per pixel
+                            of line and per sprite. The results are left on
+                            the screen, too. The clip rectangle goes back to
+                            the whole screen. Don't send anything else while
+                            it runs (it takes a few seconds on the small
+                            display); the receive interrupt would get counted
+                            as drawing time.
+  'CTRL-]'       (0x1d) - ks0108b timing profile (128x64 display only).
+                            Nonvolatile; takes effect at the next power-up.
+                            Expects two bytes: how long to hold each EN
+                            strobe, and how long to wait around each step of
+                            a read, both in microseconds.
+                            0x00,0x00 = automatic (default); at startup, we
+                                        find the shortest strobe that works
+                                        with this panel, and then wait on
+                                        the busy flag instead of fixed
+                                        delays
+                            0x05,0x0a = the original fixed timing, which
+                                        is the slowest but surest
+                            Anything from 1 to 50 sets fixed delays, with no
+                            busy flag polling, for panels that don't behave
+                            with the automatic timing. The automatic timing
+                            falls back to 0x05,0x0a by itself if the busy
+                            flag never clears. CTRL-z shows what you get.
+  'CTRL-\'        (0x1c) - Scrolling text. Expects one byte:
+                            0x00 = off (default); text that runs off the
+                                   bottom of the screen starts over at the
+                                   top of the text area (see CTRL-y)
+                            0x01 = on; the whole screen moves up a line to
+                                   make room, graphics and all, and the new
+                                   bottom line is blank
+                            Scrolling is done by the display itself, so it's
+                            about as quick as drawing one line of text. With
+                            the t6963 text layer on, only the text layer
+                            scrolls. Coordinates are always for the screen as
+                            it is now. Not stored in EEPROM.
+  'CTRL-q'       (0x11) - Status report. Sends back seven raw bytes, 16-bit
+                            values high byte first:
+                            2 bytes - received bytes dropped because the input
+                                      buffer was full
+                            2 bytes - received bytes lost by the serial port
+                                      hardware before we could read them
+                            1 byte  - the most bytes that have ever been
+                                      waiting in the input buffer at once
+                            2 bytes - frames thrown out by framed mode
+                            All of them count up from power on.
 */
 
 // These defines associate the above commands with cases in the switch
-//  statement in the code in the c file.
+//  statement in the code in the c file. Keep new commands off 0x08, 0x0a
+//  and 0x0d: in framed mode, those are backspace, line feed and carriage
+//  return in plain text, and a host's "\r\n" mustn't run anything.
 #define  CLEAR_SCREEN   0x00
 #define  RUN_DEMO       0x04
 #define  TOGGLE_BGND    0x12
@@ -95,11 +250,35 @@ This code is released under the Creative Commons Attribution Share-Alike 3.0
 #define  DRAW_BOX       0x0f
 #define  ERASE_BLOCK    0x05
 #define  DRAW_SPRITE    0x0b
+#define  TEXT_LAYER     0x14
+#define  FLOW_CONTROL   0x17
+#define  QUERY_STATUS   0x11
+#define  ACK_MODE       0x01
+#define  FRAME_MODE     0x0e
+#define  BLIT           0x09
+#define  UPDATE         0x15
+#define  SET_CLIP       0x16
+#define  FILL_BOX       0x06
+#define  BENCHMARK      0x1a
+#define  KS_TIMING      0x1d
+#define  SCROLL_MODE    0x1c
+
+#define  ACK            0x06  // What we send back in acknowledge mode.
+#define  NAK            0x15
+
+#define  UPDATE_DISCARD 0xff  // CTRL-u mode for an image we don't draw.
+
+#define  UI_MAX_ARGS    8  // Most argument bytes any command takes.
+
+// The length, CRC and payload of a frame all have to fit in the buffer below
+//  the flow control high water mark, or we'd wait forever for a frame that
+//  the host has been told to stop sending.
+#define  FRAME_MAX_LEN  (RX_HIGH_WATER-2)
 
 #define  BL_LEVEL OCR1B // Just an alias, to make it more obvious what
                         //  we're doing when we write OCR1B is setting the
                         //  backlight level.
 
-void      uiStateMachine(char command);
+void      uiStateMachine(void);
 
 #endif
@@ -0,0 +1,179 @@
+/***************************************************************************
+vlcd.c
+
+Driver support file for the serial graphical LCD backpack project. This file
+ is a virtual display: it keeps its display memory in RAM and exposes it, so
+ the rest of the code can be built and exercised without any hardware. See
+ vlcd.h for the details.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+#include "glcdbp.h"
+#include "vlcd.h"
+
+extern volatile uint8_t reverse; // Dark-on-light or light-on-dark?
+                                 //  Declared in glcdbp.c
+
+uint8_t vlcdMemory[VLCD_BYTES];  // Our "display memory".
+
+// The shape of the display we're pretending to be. These get set by the
+//  init functions.
+static uint8_t vlcdWidth = 128;
+static uint8_t vlcdHeight = 64;
+static uint8_t vlcdLayout = LAYOUT_COLUMNS;
+
+static void vlcdInit(uint8_t width, uint8_t height, uint8_t layout)
+{
+  vlcdWidth = width;
+  vlcdHeight = height;
+  vlcdLayout = layout;
+  vlcdClear();
+}
+
+void vlcdSmallInit(void)
+{
+  vlcdInit(128, 64, LAYOUT_COLUMNS);
+}
+
+void vlcdLargeInit(void)
+{
+  vlcdInit(160, 128, LAYOUT_ROWS);
+}
+
+// Find the byte of display memory holding (x, y), and which bit of it is the
+//  pixel. Returns 0 if (x, y) is off the edge of the display.
+static uint8_t *vlcdByte(uint8_t x, uint8_t y, uint8_t *bit)
+{
+  if ((x >= vlcdWidth) || (y >= vlcdHeight)) return 0;
+  if (vlcdLayout == LAYOUT_COLUMNS)
+  {
+    *bit = 1<<(y%8);
+    return &vlcdMemory[(y/8) * vlcdWidth + x];
+  }
+  *bit = 0x80>>(x%8);
+  return &vlcdMemory[y * (vlcdWidth/8) + (x>>3)];
+}
+
+// Turn one pixel ON or OFF; anything off the edge is ignored.
+static void vlcdSetPixel(uint8_t x, uint8_t y, uint8_t on)
+{
+  uint8_t bit;
+  uint8_t *p = vlcdByte(x, y, &bit);
+  if (p == 0) return;
+  if (reverse) on = !on;
+  if (on) *p |= bit;
+  else    *p &= ~bit;
+}
+
+// Is the pixel at (x, y) lit? Off the edge, nothing is.
+uint8_t vlcdGetPixel(uint8_t x, uint8_t y)
+{
+  uint8_t bit;
+  uint8_t *p = vlcdByte(x, y, &bit);
+  if (p == 0) return 0;
+  return (*p & bit) ? 1 : 0;
+}
+
+void vlcdClear(void)
+{
+  uint8_t fill = reverse ? 0xff : 0x00;
+  for (uint16_t i = 0; i < VLCD_BYTES; i++) vlcdMemory[i] = fill;
+}
+
+// Bytes along a line: one column apart on a column display, 8 pixels apart on
+//  a row display. Off the edge, we read zeroes.
+void vlcdReadBytes(uint8_t x, uint8_t y, uint8_t *dst, uint8_t n)
+{
+  uint8_t step = (vlcdLayout == LAYOUT_COLUMNS) ? 1 : 8;
+  uint8_t bit;
+  for (uint8_t i = 0; i < n; i++)
+  {
+    uint8_t *p = vlcdByte(x + (i * step), y, &bit);
+    dst[i] = p ? *p : 0;
+  }
+}
+
+void vlcdWriteBits(uint8_t x, uint8_t y, uint8_t set, uint8_t clear)
+{
+  uint8_t bit;
+  uint8_t *p = vlcdByte(x, y, &bit);
+  if (p == 0) return;
+  if (reverse)
+  {
+    uint8_t temp = set;
+    set = clear;
+    clear = temp;
+  }
+  *p = (*p | set) & ~clear;
+}
+
+// On a column display, each byte of src is a whole column of the page; on a
+//  row display, it's 8 pixels of the row, bit 7 first.
+void vlcdWriteRun(uint8_t x, uint8_t y, uint8_t width, const uint8_t *src)
+{
+  for (uint8_t i = 0; i < width; i++)
+  {
+    if (vlcdLayout == LAYOUT_COLUMNS)
+    {
+      vlcdWriteBits(x+i, y, src[i], ~src[i]);
+    }
+    else
+    {
+      vlcdSetPixel(x+i, y, (src[i>>3]<<(i&0x07)) & 0x80);
+    }
+  }
+}
+
+void vlcdFillRun(uint8_t x, uint8_t y, uint8_t width, PIX_VAL pixel)
+{
+  uint8_t value = (pixel == ON) ? 0xff : 0x00;
+  for (uint8_t i = 0; i < width; i++)
+  {
+    if (vlcdLayout == LAYOUT_COLUMNS) vlcdWriteBits(x+i, y, value, ~value);
+    else                              vlcdSetPixel(x+i, y, value);
+  }
+}
+
+// Scroll up a line of text. We haven't got a start line register to play
+//  with, so the memory itself moves; a line is a page on the small display,
+//  and 8 rows on the large one, and either way it's the first line's worth
+//  of bytes.
+void vlcdScroll(void)
+{
+  uint16_t size = (vlcdWidth/8) * vlcdHeight;
+  uint16_t line = vlcdWidth;
+  memmove(vlcdMemory, vlcdMemory + line, size - line);
+  memset(vlcdMemory + size - line, reverse ? 0xff : 0x00, line);
+}
+
+// The 8x8 block for the sprites: buffer[i] is column x+i, with the pixel at
+//  the top of the block in bit 7. This is what ks0108bReadBlock() is after,
+//  too, and like it, we hand back the pixels as they are in display memory.
+void vlcdReadBlock(uint8_t x, uint8_t y, uint8_t *buffer)
+{
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    buffer[i] = 0;
+    for (uint8_t j = 0; j < 8; j++)
+    {
+      if (vlcdGetPixel(x+i, y+j)) buffer[i] |= 0x80>>j;
+    }
+  }
+}
+
+// How lcd.c sees us; see LCD_DRIVER in glcdbp.h.
+const LCD_DRIVER vlcdSmallDriver PROGMEM =
+  {128, 64, LAYOUT_COLUMNS, vlcdSmallInit, vlcdClear, 0, vlcdReadBytes,
+   vlcdWriteBits, vlcdWriteRun, vlcdFillRun, vlcdReadBlock, 0, 0, 0,
+   vlcdScroll, 0};
+const LCD_DRIVER vlcdLargeDriver PROGMEM =
+  {160, 128, LAYOUT_ROWS, vlcdLargeInit, vlcdClear, 0, vlcdReadBytes,
+   vlcdWriteBits, vlcdWriteRun, vlcdFillRun, vlcdReadBlock, 0, 0, 0,
+   vlcdScroll, 0};
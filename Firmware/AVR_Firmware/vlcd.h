@@ -0,0 +1,56 @@
+/***************************************************************************
+vlcd.h
+
+Virtual display driver header file. Function prototypes and the two driver
+ descriptors.
+
+This code is released under the Creative Commons Attribution Share-Alike 3.0
+ license. You are free to reuse, remix, or redistribute it as you see fit,
+ so long as you provide attribution to SparkFun Electronics.
+
+***************************************************************************/
+
+
+#ifndef __vlcd_h
+#define __vlcd_h
+
+// Enough display memory for the bigger of the two real displays. That's
+//  more RAM than the ATmega168 *has*, which is fine- this driver is for
+//  building the drawing code on a PC, not for the backpack.
+#define VLCD_BYTES 2560
+
+void     vlcdSmallInit(void);
+void     vlcdLargeInit(void);
+void     vlcdClear(void);
+void     vlcdReadBytes(uint8_t x, uint8_t y, uint8_t *dst, uint8_t n);
+void     vlcdWriteBits(uint8_t x, uint8_t y, uint8_t set, uint8_t clear);
+void     vlcdWriteRun(uint8_t x, uint8_t y, uint8_t width, const uint8_t *src);
+void     vlcdFillRun(uint8_t x, uint8_t y, uint8_t width, PIX_VAL pixel);
+void     vlcdReadBlock(uint8_t x, uint8_t y, uint8_t *buffer);
+void     vlcdScroll(void);
+uint8_t  vlcdGetPixel(uint8_t x, uint8_t y);
+
+extern uint8_t vlcdMemory[VLCD_BYTES];
+extern const LCD_DRIVER vlcdSmallDriver;
+extern const LCD_DRIVER vlcdLargeDriver;
+
+#endif
+
+/*
+The virtual display is a display that isn't there. It keeps its "display
+memory" in an ordinary array and does to it exactly what a real controller
+would do to its own, so everything above the driver- lcd.c, ui.c, the serial
+code- can be built and run on a PC, and the results checked by looking at the
+array instead of squinting at the glass.
+
+It comes in two shapes, to match the two real displays: vlcdSmallDriver is a
+128x64 column-organized display like the ks0108b, and vlcdLargeDriver is a
+160x128 row-organized one like the t6963 (minus the text layer). Pick one by
+building lcd.c with VIRTUAL_LCD defined; lcdConfig() then uses 'display' to
+choose between them, just as it would between the real drivers.
+
+vlcdMemory holds the bytes in the same order the real controller would: page
+by page, one byte per column, for the small one, and row by row, 20 bytes per
+row, for the large one. Like real display memory, a set bit is a lit pixel;
+reverse mode is already applied. vlcdGetPixel() saves working that out.
+*/
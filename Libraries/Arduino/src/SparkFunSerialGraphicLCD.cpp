@@ -15,7 +15,59 @@ SoftwareSerial serial(2,3);//change these two pin values to whichever pins you w
 LCD::LCD()
 {
 	serial.begin(115200);
-
+	ackWindow = 0;
+	outstanding = 0;
+}
+//-------------------------------------------------------------------------------------------
+void LCD::setAckWindow(byte window)
+{
+  //With a window of 0 (the default), we don't hear anything back from the LCD, so the
+  //drawing commands just wait 10ms and hope that was long enough. Any other value turns on
+  //acknowledge mode in the LCD; then we can have up to window commands in flight before we
+  //stop and wait for the LCD to tell us one of them is done. That way the LCD always has
+  //something to work on, and we never wait longer than we need to.
+  sync();
+  startCommand(0x01);//CTRL a
+  serial.write(window ? 0x01 : 0x00);
+  ackWindow = window;
+  outstanding = window ? 1 : 0;//the LCD acknowledges the command that turns acks on
+}
+//-------------------------------------------------------------------------------------------
+void LCD::sync()
+{
+  //wait until the LCD has finished every command we've sent it
+  while(outstanding) waitForAck();
+}
+//-------------------------------------------------------------------------------------------
+void LCD::waitForAck()
+{
+  //SoftwareSerial can miss a byte that arrives while it's transmitting, so if an ack
+  //doesn't show up in a reasonable amount of time, assume we missed it and move on.
+  unsigned long start = millis();
+  while(millis() - start < 250)
+  {
+	int c = serial.read();
+	if(c == 0x06 || c == 0x15) break;//ACK, or NAK for a command the LCD didn't know
+  }
+  outstanding--;
+}
+//-------------------------------------------------------------------------------------------
+void LCD::startCommand(byte cmd)
+{
+  //every command goes through here, so we can keep count of them in acknowledge mode
+  if(ackWindow)
+  {
+	while(outstanding >= ackWindow) waitForAck();
+	outstanding++;
+  }
+  serial.write(0x7C);
+  serial.write(cmd);
+}
+//-------------------------------------------------------------------------------------------
+void LCD::endDraw()
+{
+  //the old way: give the LCD time to finish drawing before we send anything else
+  if(ackWindow == 0) delay(10);
 }
 //-------------------------------------------------------------------------------------------
 void LCD::printStr(char Str[78])//26 characters is the length of one line on the LCD
@@ -37,39 +89,35 @@ void LCD::nextLine()//prints new line
 void LCD::clearScreen()
 {
   //clears the screen, you will use this a lot!
-  serial.write(0x7C);
-  serial.write((byte)0); //CTRL @
+  startCommand(0x00); //CTRL @
   //can't send LCD.write(0) or LCD.write(0x00) because it's interprestted as a NULL
 }
 //-------------------------------------------------------------------------------------------
 void LCD::toggleReverseMode()
 {
   //Everything that was black is now white and vise versa
-  serial.write(0x7C);
-  serial.write(0x12); //CTRL r
+  startCommand(0x12); //CTRL r
 }
 //-------------------------------------------------------------------------------------------
 void LCD::toggleSplash()
 {
   //turns the splash screen on and off, the 1 second delay at startup stays either way.
-  serial.write(0x7C);
-  serial.write(0x13); //CTRL s
+  startCommand(0x13); //CTRL s
 }
 //-------------------------------------------------------------------------------------------
 void LCD::setBacklight(byte duty)
 {
   //changes the back light intensity, range is 0-100.
-  serial.write(0x7C);
-  serial.write(0x02); //CTRL b
+  startCommand(0x02); //CTRL b
   serial.write(duty); //send a value of 0 - 100
 }
 //-------------------------------------------------------------------------------------------
 void LCD::setBaud(byte baud)
 {
   //changes the baud rate.
-  serial.write(0x7C);
-  serial.write(0x07); //CTRL g
-  serial.write(baud); //send a value of 49 - 54
+  sync();//the ack for this one comes back at the new rate, so don't count on seeing it
+  startCommand(0x07); //CTRL g
+  serial.write(baud); //send a value of 48 - 57
   delay(100);
 
 /*
@@ -79,39 +127,37 @@ void LCD::setBaud(byte baud)
 “4” = 38,400bps - 0x34 = 52
 “5” = 57,600bps - 0x35 = 53
 “6” = 115,200bps - 0x36 = 54
+“7” = 230,400bps - 0x37 = 55
+“8” = 250,000bps - 0x38 = 56
+“9” = 500,000bps - 0x39 = 57
+“0” = 1,000,000bps - 0x30 = 48
 */
 
   //these statements change the SoftwareSerial baud rate to match the baud rate of the LCD. 
-  if(baud == 49)
+  //SoftwareSerial can't keep up with anything past 115200 on a 16MHz board, so the last
+  //four rates are only useful if you change serial (at the top of this file) to one of
+  //the hardware serial ports, like Serial1 on a Mega or Leonardo.
+  long rate = 0;
+  switch(baud)
   {
-	serial.end();
-	serial.begin(4800);
+	case 49: rate = 4800; break;
+	case 50: rate = 9600; break;
+	case 51: rate = 19200; break;
+	case 52: rate = 38400; break;
+	case 53: rate = 57600; break;
+	case 54: rate = 115200; break;
+	case 55: rate = 230400; break;
+	case 56: rate = 250000; break;
+	case 57: rate = 500000; break;
+	case 48: rate = 1000000; break;
   }
-  if(baud == 50)
+  if(rate != 0)
   {
 	serial.end();
-	serial.begin(9600);
-  }
-  if(baud == 51)
-  {
-	serial.end();
-	serial.begin(19200);
-  }
-  if(baud == 52)
-  {
-	serial.end();
-	serial.begin(38400);
-  }
-  if(baud == 53)
-  {
-	serial.end();
-	serial.begin(57600);
-  }
-  if(baud == 54)
-  {
-	serial.end();
-	serial.begin(115200);
+	serial.begin(rate);
   }
+  while(serial.available()) serial.read();
+  outstanding = 0;
 }
 //-------------------------------------------------------------------------------------------
 void LCD::restoreDefaultBaud()
@@ -158,6 +204,7 @@ delay(10);
 serial.write(0x7C);
 serial.write((byte)0); //clearScreen
 serial.print("Baud restored to 115200!");
+outstanding = 0;
 delay(5000);
 
 }
@@ -165,15 +212,13 @@ delay(5000);
 void LCD::demo()
 {
   //Demonstartes all the capabilities of the LCD
-  serial.write(0x7C);
-  serial.write(0x04);//CTRL d
+  startCommand(0x04);//CTRL d
 }
 //-------------------------------------------------------------------------------------------
 void LCD::setX(byte posX) //0-127 or 0-159 pixels
 {
   //Set the X position 
-  serial.write(0x7C);
-  serial.write(0x18);//CTRL x
+  startCommand(0x18);//CTRL x
   serial.write(posX);
 
 //characters are 8 pixels tall x 6 pixels wide
@@ -199,58 +244,52 @@ void LCD::setX(byte posX) //0-127 or 0-159 pixels
 void LCD::setY(byte posY)//0-63 or 0-127 pixels
 {
   //Set the y position 
-  serial.write(0x7C);
-  serial.write(0x19);//CTRL y
+  startCommand(0x19);//CTRL y
   serial.write(posY);
   
 }
 //-------------------------------------------------------------------------------------------
 void LCD::setHome()
 {
-  serial.write(0x7C);
-  serial.write(0x18); 
+  startCommand(0x18); 
   serial.write((byte)0);//set x back to 0
   
-  serial.write(0x7C);
-  serial.write(0x19); 
+  startCommand(0x19); 
   serial.write((byte)0);//set y back to 0
 }
 //-------------------------------------------------------------------------------------------
 void LCD::setPixel(byte x, byte y, byte set)
 {
-  serial.write(0x7C);
-  serial.write(0x10);//CTRL p
+  startCommand(0x10);//CTRL p
   serial.write(x);
   serial.write(y);
   serial.write(0x01);
-  delay(10);
+  endDraw();
 }
 //-------------------------------------------------------------------------------------------
 void LCD::drawLine(byte x1, byte y1, byte x2, byte y2, byte set)
 {
   //draws a line from two given points. You can set and reset just as the pixel function. 
-  serial.write(0x7C);
-  serial.write(0x0C);//CTRL l 
+  startCommand(0x0C);//CTRL l 
   serial.write(x1);
   serial.write(y1);
   serial.write(x2);
   serial.write(y2);
   serial.write(0x01);
-  delay(10);
+  endDraw();
 	
 }
 //-------------------------------------------------------------------------------------------
 void LCD::drawBox(byte x1, byte y1, byte x2, byte y2, byte set)
 {
   //draws a box from two given points. You can set and reset just as the pixel function. 
-  serial.write(0x7C);
-  serial.write(0x0F);//CTRL o 
+  startCommand(0x0F);//CTRL o 
   serial.write(x1);
   serial.write(y1);
   serial.write(x2);
   serial.write(y2);
   serial.write(0x01);
-  delay(10);
+  endDraw();
 	
 }
 //-------------------------------------------------------------------------------------------
@@ -259,25 +298,23 @@ void LCD::drawCircle(byte x, byte y, byte rad, byte set)
 //draws a circle from a point x,y with a radius of rad. 
 //Circles can be drawn off-grid, but only those pixels that fall within the 
 //display boundaries will be written.
-  serial.write(0x7C);
-  serial.write(0x03);//CTRL c 
+  startCommand(0x03);//CTRL c 
   serial.write(x);
   serial.write(y);
   serial.write(rad);
   serial.write(0x01);
-  delay(10);
+  endDraw();
 	
 }
 //-------------------------------------------------------------------------------------------
 void LCD::eraseBlock(byte x1, byte y1, byte x2, byte y2)
 {
   //This is just like the draw box command, except the contents of the box are erased to the background color
-  serial.write(0x7C);
-  serial.write(0x05);//CTRL e 
+  startCommand(0x05);//CTRL e 
   serial.write(x1);
   serial.write(y1);
   serial.write(x2);
   serial.write(y2);
-  delay(10);
+  endDraw();
 	
 }
\ No newline at end of file
@@ -34,12 +34,16 @@ class LCD
 	void drawBox(byte x1, byte y1, byte x2, byte y2, byte set);
 	void drawCircle(byte x, byte y, byte rad, byte set);
 	void eraseBlock(byte x1, byte y1, byte x2, byte y2);
+	void setAckWindow(byte window);
+	void sync();
 	
 	
 	private:
-    
-    
-    
+	void startCommand(byte cmd);
+	void endDraw();
+	void waitForAck();
+	byte ackWindow;
+	byte outstanding;
 
 };
 